@@ -0,0 +1,269 @@
+//! ============================================================================
+//! \file benchmark.cpp
+//! \brief Benchmarks of DynamicLibrary
+//! ============================================================================
+
+#include "DynamicLibrary/DynamicLibrary.hpp"
+#include <chrono>
+#include <cstdint>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <fstream>
+#include <iomanip>
+#include <iostream>
+#include <memory>
+#include <string>
+#include <vector>
+
+#ifdef __linux__
+#    include <linux/perf_event.h>
+#    include <sys/ioctl.h>
+#    include <sys/syscall.h>
+#    include <unistd.h>
+#endif
+
+#ifdef _WIN32
+#    define LIB_EXTENSION ".dll"
+#elif defined(__APPLE__)
+#    define LIB_EXTENSION ".dylib"
+#else
+#    define LIB_EXTENSION ".so"
+#endif
+
+typedef std::size_t (*StageCountFunction)();
+typedef unsigned (*RunStagesFunction)(unsigned, std::size_t);
+
+//-----------------------------------------------------------------------------
+//! \brief Counter of the iTLB misses of the calling thread, in user space.
+//! Reads -1 when the counter is not available (not Linux, no hardware
+//! counters in a virtual machine, perf_event_paranoid ...).
+//-----------------------------------------------------------------------------
+class ITlbMisses
+{
+public:
+
+    ITlbMisses()
+    {
+#ifdef __linux__
+        struct perf_event_attr attr;
+        std::memset(&attr, 0, sizeof(attr));
+        attr.size = sizeof(attr);
+        attr.type = PERF_TYPE_HW_CACHE;
+        attr.config = PERF_COUNT_HW_CACHE_ITLB |
+                      (PERF_COUNT_HW_CACHE_OP_READ << 8) |
+                      (PERF_COUNT_HW_CACHE_RESULT_MISS << 16);
+        attr.disabled = 1;
+        attr.exclude_kernel = 1;
+        attr.exclude_hv = 1;
+        m_fd = static_cast<int>(
+            syscall(__NR_perf_event_open, &attr, 0, -1, -1, 0));
+#endif
+    }
+
+    ~ITlbMisses()
+    {
+#ifdef __linux__
+        if (m_fd >= 0)
+        {
+            close(m_fd);
+        }
+#endif
+    }
+
+    void start()
+    {
+#ifdef __linux__
+        if (m_fd >= 0)
+        {
+            ioctl(m_fd, PERF_EVENT_IOC_RESET, 0);
+            ioctl(m_fd, PERF_EVENT_IOC_ENABLE, 0);
+        }
+#endif
+    }
+
+    std::int64_t stop()
+    {
+        std::int64_t count = -1;
+#ifdef __linux__
+        if (m_fd >= 0)
+        {
+            ioctl(m_fd, PERF_EVENT_IOC_DISABLE, 0);
+            if (read(m_fd, &count, sizeof(count)) != sizeof(count))
+            {
+                count = -1;
+            }
+        }
+#endif
+        return count;
+    }
+
+private:
+
+    int m_fd = -1;
+};
+
+//-----------------------------------------------------------------------------
+//! \brief Run the stages of libhotcode and report the call throughput and
+//! the iTLB misses.
+//-----------------------------------------------------------------------------
+static void run_hot_code(const char* p_label, dl::HugePages p_huge_pages)
+{
+    dl::DynamicLibrary lib;
+    lib.setHugePageText(p_huge_pages);
+    if (!lib.load("./libhotcode.so", dl::AutoReload::Disabled))
+    {
+        std::cerr << lib.getErrorMessage() << std::endl;
+        return;
+    }
+
+    auto stage_count = lib.getSymbol<StageCountFunction>("stage_count");
+    auto run_stages = lib.getSymbol<RunStagesFunction>("run_stages");
+    if (!stage_count || !run_stages)
+    {
+        std::cerr << lib.getErrorMessage() << std::endl;
+        return;
+    }
+
+    const std::size_t rounds = 50000u;
+    volatile unsigned sink = run_stages(1u, 1000u); // Warm up
+
+    ITlbMisses misses;
+    misses.start();
+    auto start = std::chrono::steady_clock::now();
+    sink = run_stages(sink, rounds);
+    auto elapsed = std::chrono::steady_clock::now() - start;
+    std::int64_t itlb_misses = misses.stop();
+
+    const double calls = double(rounds) * double(stage_count());
+    const double seconds = std::chrono::duration<double>(elapsed).count();
+    std::cout << std::left << std::setw(14) << p_label << std::right
+              << std::setw(10) << (lib.getHugePageTextSize() >> 20)
+              << " MiB" << std::setw(12) << std::fixed << std::setprecision(1)
+              << (calls / seconds / 1e6) << " Mcalls/s";
+    if (itlb_misses >= 0)
+    {
+        std::cout << std::setw(12) << std::setprecision(3)
+                  << (double(itlb_misses) / calls) << " iTLB misses/call";
+    }
+    else
+    {
+        std::cout << "  iTLB misses: counter not available";
+    }
+    std::cout << std::endl;
+}
+
+//-----------------------------------------------------------------------------
+void benchmark_huge_page_text()
+{
+    std::cout << "\033[32m=== Code on huge pages (libhotcode) ===\033[0m"
+              << std::endl;
+    std::cout << "Check /sys/kernel/mm/transparent_hugepage/enabled is not "
+                 "'never'"
+              << std::endl;
+    run_hot_code("4 KiB pages", dl::HugePages::Disabled);
+    run_hot_code("huge pages", dl::HugePages::Enabled);
+}
+
+//-----------------------------------------------------------------------------
+//! \brief Average duration of a call, in nanoseconds
+//-----------------------------------------------------------------------------
+template <typename Call>
+static double nanoseconds_per_call(std::size_t p_count, Call&& p_call)
+{
+    auto start = std::chrono::steady_clock::now();
+    for (std::size_t i = 0u; i < p_count; ++i)
+    {
+        p_call(i);
+    }
+    auto elapsed = std::chrono::steady_clock::now() - start;
+    return std::chrono::duration<double, std::nano>(elapsed).count() /
+           double(p_count);
+}
+
+//-----------------------------------------------------------------------------
+//! \brief Check thousands of libraries for updates, watched by the inotify
+//! thread of a manager or checked with stat. The libraries are registered
+//! without being loaded: only their files matter.
+//-----------------------------------------------------------------------------
+void benchmark_watched_libraries()
+{
+    std::cout << "\033[32m=== Update checks of 5000 libraries ===\033[0m"
+              << std::endl;
+
+    const std::size_t count = 5000u;
+    char directory[] = "/tmp/dl-benchmark-XXXXXX";
+    if (mkdtemp(directory) == nullptr)
+    {
+        std::cerr << "Cannot create a temporary directory" << std::endl;
+        return;
+    }
+    std::vector<std::string> paths;
+    for (std::size_t i = 0u; i < count; ++i)
+    {
+        paths.push_back(std::string(directory) + "/lib" + std::to_string(i) +
+                        LIB_EXTENSION);
+        std::ofstream(paths.back()) << "not loaded";
+    }
+
+    {
+        dl::DynamicLibraryManager manager;
+        std::vector<std::shared_ptr<dl::DynamicLibrary>> watched;
+        std::vector<std::unique_ptr<dl::DynamicLibrary>> stated;
+        for (std::size_t i = 0u; i < count; ++i)
+        {
+            watched.push_back(manager.registerLibrary(
+                std::to_string(i), paths[i], dl::AutoReload::Disabled));
+            stated.emplace_back(new dl::DynamicLibrary());
+            stated.back()->loadLazy(paths[i], dl::AutoReload::Disabled);
+        }
+        manager.findUpdatedLibraries(); // Consume the initial checks
+
+        const std::size_t rounds = 20u;
+        std::cout << std::fixed << std::setprecision(1)
+                  << "checkForUpdates(), watched:   " << std::setw(10)
+                  << nanoseconds_per_call(
+                         rounds * count,
+                         [&](std::size_t i)
+                         { watched[i % count]->checkForUpdates(); })
+                  << " ns" << std::endl;
+        std::cout << "checkForUpdates(), stat:      " << std::setw(10)
+                  << nanoseconds_per_call(
+                         rounds * count,
+                         [&](std::size_t i)
+                         { stated[i % count]->checkForUpdates(); })
+                  << " ns" << std::endl;
+        std::cout << "findUpdatedLibraries():       " << std::setw(10)
+                  << nanoseconds_per_call(
+                         rounds,
+                         [&](std::size_t)
+                         { manager.findUpdatedLibraries(); }) /
+                         1000.0
+                  << " us" << std::endl;
+
+        // Time for a modification to be reported by a full scan
+        std::ofstream(paths[count / 2u], std::ios::app) << " modified";
+        auto start = std::chrono::steady_clock::now();
+        while (manager.findUpdatedLibraries().empty())
+        {
+        }
+        auto latency = std::chrono::steady_clock::now() - start;
+        std::cout << "Modification reported after:  " << std::setw(10)
+                  << std::chrono::duration<double, std::micro>(latency).count()
+                  << " us" << std::endl;
+    }
+
+    for (const auto& path : paths)
+    {
+        std::remove(path.c_str());
+    }
+    std::remove(directory);
+}
+
+//-----------------------------------------------------------------------------
+int main()
+{
+    benchmark_huge_page_text();
+    benchmark_watched_libraries();
+    return 0;
+}
@@ -0,0 +1,55 @@
+//! ============================================================================
+//! \file hotcode_lib.cpp
+//! \brief Library with large hot code: each stage sits on its own 64 KiB
+//! boundary, so running all of them touches 256 code pages spread over
+//! 16 MiB with 4 KiB pages, but only 8 pages with 2 MiB pages.
+//! ============================================================================
+
+#include <array>
+#include <cstddef>
+#include <utility>
+
+namespace
+{
+
+constexpr std::size_t STAGES = 256u;
+
+using Stage = unsigned (*)(unsigned);
+
+template <std::size_t N>
+__attribute__((noinline, aligned(65536))) unsigned stage(unsigned p_value)
+{
+    return p_value * (2u * N + 1u) + N;
+}
+
+template <std::size_t... I>
+std::array<Stage, STAGES> makeStages(std::index_sequence<I...>)
+{
+    // Scattered order, so that the next code page cannot be prefetched
+    return { { &stage<(I * 97u) % STAGES>... } };
+}
+
+const std::array<Stage, STAGES> stages =
+    makeStages(std::make_index_sequence<STAGES>{});
+
+} // namespace
+
+extern "C"
+{
+    std::size_t stage_count()
+    {
+        return STAGES;
+    }
+
+    unsigned run_stages(unsigned p_value, std::size_t p_rounds)
+    {
+        for (std::size_t round = 0u; round < p_rounds; ++round)
+        {
+            for (Stage stage_function : stages)
+            {
+                p_value = stage_function(p_value);
+            }
+        }
+        return p_value;
+    }
+}
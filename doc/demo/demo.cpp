@@ -3,6 +3,7 @@
 //! \brief Example of using the dynamic library
 //! ============================================================================
 
+#include "DynamicLibrary/BatchedFunction.hpp"
 #include "DynamicLibrary/DynamicLibrary.hpp"
 #include <chrono>
 #include <filesystem>
@@ -246,6 +247,70 @@ void example_reload_detection()
     }
 }
 
+//-----------------------------------------------------------------------------
+void example_origin_dependency()
+{
+    std::cout << "\033[32m=== $ORIGIN dependency example ===\033[0m"
+              << std::endl;
+
+    try
+    {
+        // liborigin needs libexample, found in the directory of liborigin
+        dl::DynamicLibrary lib("./liborigin" LIB_EXTENSION,
+                               dl::AutoReload::Disabled);
+        auto add_twice = lib.getSymbol<AddFunction>("add_twice");
+        std::cout << "(5 + 3) + 3 = " << add_twice(5, 3) << std::endl;
+    }
+    catch (const dl::DynamicLibraryException& e)
+    {
+        std::cerr << "\033[31mError: " << e.what() << "\033[0m" << std::endl;
+    }
+}
+
+//-----------------------------------------------------------------------------
+void example_batched_calls()
+{
+    std::cout << "\033[32m=== Batched calls example ===\033[0m" << std::endl;
+
+    try
+    {
+        dl::DynamicLibrary lib("./libexample" LIB_EXTENSION,
+                               dl::AutoReload::Disabled);
+
+        // The calls are buffered then sent to add_batch() in one go
+        dl::BatchedFunction<int(int, int), 4u> add(lib, "add");
+        std::vector<int> sums(10);
+        for (int i = 0; i < 10; ++i)
+        {
+            add.push(sums[i], i, 10 * i);
+        }
+        add.flush();
+
+        std::cout << "add_batch() exported: " << std::boolalpha
+                  << add.isBatched() << std::endl;
+        std::cout << "i + 10 * i =";
+        for (int sum : sums)
+        {
+            std::cout << " " << sum;
+        }
+        std::cout << std::endl;
+
+        // multiply() has no batched version: the batch is run through it,
+        // and the missing multiply_batch() is not reported as an error
+        dl::BatchedFunction<int(int, int)> multiply(lib, "multiply");
+        int product = 0;
+        multiply.push(product, 6, 7);
+        multiply.flush();
+        std::cout << "6 * 7 = " << product << ", multiply_batch() exported: "
+                  << multiply.isBatched() << ", error: '"
+                  << lib.getErrorMessage() << "'" << std::endl;
+    }
+    catch (const dl::DynamicLibraryException& e)
+    {
+        std::cerr << "\033[31mError: " << e.what() << "\033[0m" << std::endl;
+    }
+}
+
 //-----------------------------------------------------------------------------
 int main()
 {
@@ -254,6 +319,8 @@ int main()
     example_manager();
     example_error_handling();
     example_reload_detection();
+    example_batched_calls();
+    example_origin_dependency();
 
     return EXIT_SUCCESS;
 }
\ No newline at end of file
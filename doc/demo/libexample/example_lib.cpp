@@ -3,8 +3,12 @@
 //! \brief Normal library that can be unloaded
 //! ============================================================================
 
+#include "DynamicLibrary/PluginMetadata.hpp"
+#include <cstddef>
 #include <iostream>
 
+DL_PLUGIN_METADATA("example", "1.0.0", "math,print", "")
+
 extern "C"
 {
     int add(int a, int b)
@@ -12,6 +16,15 @@ extern "C"
         return a + b;
     }
 
+    // Batched version of add(), found by dl::BatchedFunction
+    void add_batch(const int* a, const int* b, int* out, std::size_t n)
+    {
+        for (std::size_t i = 0u; i < n; ++i)
+        {
+            out[i] = a[i] + b[i];
+        }
+    }
+
     int multiply(int a, int b)
     {
         return a * b;
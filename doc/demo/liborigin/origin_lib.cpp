@@ -0,0 +1,15 @@
+//! ============================================================================
+//! \file origin_lib.cpp
+//! \brief Library depending on libexample, found through its $ORIGIN runpath
+//! ============================================================================
+
+extern "C"
+{
+    // Exported by libexample
+    int add(int a, int b);
+
+    int add_twice(int a, int b)
+    {
+        return add(add(a, b), b);
+    }
+}
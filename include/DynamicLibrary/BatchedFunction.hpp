@@ -0,0 +1,297 @@
+#pragma once
+
+//! ***************************************************************************
+//! \brief Batched calling convention for the functions of a plugin.
+//!
+//! Next to a scalar function "fn", a plugin may export "fn_batch" taking one
+//! array per argument, the output array and the number of elements:
+//!
+//!   int add(int a, int b);
+//!   void add_batch(const int* a, const int* b, int* out, std::size_t n);
+//!
+//! The host pushes calls one by one: they are buffered in aligned arrays and
+//! sent to "fn_batch" once the batch is full (or on flush()), so that the
+//! plugin can vectorize the loop and the call overhead is paid once per
+//! batch. When the plugin only exports "fn", the batch is run through it.
+//!
+//!   dl::BatchedFunction<int(int, int)> add(library, "add");
+//!   for (std::size_t i = 0u; i < n; ++i)
+//!       add.push(sums[i], a[i], b[i]);
+//!   add.flush(); // sums[] is filled
+//! ***************************************************************************
+
+#include "DynamicLibrary/DynamicLibrary.hpp"
+
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <string>
+#include <tuple>
+#include <type_traits>
+#include <utility>
+
+namespace dl
+{
+
+template <typename Signature, std::size_t BATCH = 256u>
+class BatchedFunction;
+
+namespace detail
+{
+template <std::size_t N>
+constexpr bool allTriviallyCopyable(const bool (&p_traits)[N])
+{
+    for (bool trait : p_traits)
+    {
+        if (!trait)
+        {
+            return false;
+        }
+    }
+    return true;
+}
+} // namespace detail
+
+//! ***************************************************************************
+//! \brief Typed batched call of a plugin function.
+//! \tparam Out Result of the function (trivially copyable, not void).
+//! \tparam Args Arguments of the function (trivially copyable, by value).
+//! \tparam BATCH Number of calls buffered before an automatic flush.
+//! \note Not thread-safe: use one instance per thread. The results given to
+//!   push() must stay valid until the next flush.
+//! ***************************************************************************
+template <typename Out, typename... Args, std::size_t BATCH>
+class BatchedFunction<Out(Args...), BATCH>
+{
+    static_assert(BATCH > 0u, "BATCH must not be zero");
+    static_assert(!std::is_void<Out>::value, "Out must not be void");
+    static_assert(std::is_trivially_copyable<Out>::value,
+                  "Out must be trivially copyable");
+    static_assert(detail::allTriviallyCopyable({
+                      std::is_trivially_copyable<Args>::value..., true }),
+                  "Args must be trivially copyable");
+
+public:
+
+    //! \brief Scalar function "fn"
+    using Scalar = Out (*)(Args...);
+    //! \brief Batched function "fn_batch"
+    using Batch = void (*)(const Args*..., Out*, std::size_t);
+
+    //! \brief Alignment of the buffers (a cache line, enough for AVX-512)
+    static constexpr std::size_t ALIGNMENT = 64u;
+
+    //!------------------------------------------------------------------------
+    //! \brief Constructor.
+    //! \param p_library Library exporting the function, which must outlive
+    //!   this object.
+    //! \param p_function_name Name of the scalar function, the batched one
+    //!   being suffixed with "_batch".
+    //!------------------------------------------------------------------------
+    BatchedFunction(DynamicLibrary& p_library, std::string p_function_name)
+        : m_library(p_library),
+          m_name(std::move(p_function_name)),
+          m_batch_name(m_name + "_batch")
+    {
+        allocate();
+    }
+
+    //!------------------------------------------------------------------------
+    //! \brief Destructor. Flush the pending calls.
+    //!------------------------------------------------------------------------
+    ~BatchedFunction()
+    {
+        flush();
+    }
+
+    BatchedFunction(const BatchedFunction&) = delete;
+    BatchedFunction& operator=(const BatchedFunction&) = delete;
+
+    //!------------------------------------------------------------------------
+    //! \brief Queue a call, flushing the batch when it is full.
+    //! \param p_result Receives the result of the call on the flush.
+    //! \param p_args Arguments of the call.
+    //! \return false if an automatic flush failed (see flush()).
+    //!------------------------------------------------------------------------
+    bool push(Out& p_result, Args... p_args)
+    {
+        store(std::index_sequence_for<Args...>{}, p_args...);
+        m_results[m_size] = &p_result;
+        if (++m_size < BATCH)
+        {
+            return true;
+        }
+        return flush();
+    }
+
+    //!------------------------------------------------------------------------
+    //! \brief Run the pending calls and write their results.
+    //! \return false if the library does not export the function: the
+    //!   pending calls are dropped and their results left untouched. The
+    //!   error message can be retrieved with getErrorMessage().
+    //!------------------------------------------------------------------------
+    bool flush()
+    {
+        if (m_size == 0u)
+        {
+            return true;
+        }
+        const std::size_t count = m_size;
+        m_size = 0u;
+
+        // getSymbol() once per batch keeps the automatic reload working
+        // while the batched symbol is only resolved again after a reload
+        Scalar scalar = m_library.getSymbol<Scalar>(m_name);
+        if (scalar == nullptr)
+        {
+            return false;
+        }
+        run(resolve(), scalar, std::index_sequence_for<Args...>{}, count);
+        for (std::size_t i = 0u; i < count; ++i)
+        {
+            *m_results[i] = m_outputs[i];
+        }
+        return true;
+    }
+
+    //!------------------------------------------------------------------------
+    //! \brief Call the function on arrays of the caller, without buffering.
+    //! \param p_args One array of p_count elements per argument.
+    //! \param p_outputs Array of p_count elements receiving the results.
+    //! \param p_count Number of calls.
+    //! \return false if the library does not export the function.
+    //! \note The pending calls of push() are not flushed.
+    //!------------------------------------------------------------------------
+    bool invoke(const Args*... p_args, Out* p_outputs, std::size_t p_count)
+    {
+        Scalar scalar = m_library.getSymbol<Scalar>(m_name);
+        if (scalar == nullptr)
+        {
+            return false;
+        }
+        if (Batch batch = resolve())
+        {
+            batch(p_args..., p_outputs, p_count);
+        }
+        else
+        {
+            for (std::size_t i = 0u; i < p_count; ++i)
+            {
+                p_outputs[i] = scalar(p_args[i]...);
+            }
+        }
+        return true;
+    }
+
+    //!------------------------------------------------------------------------
+    //! \brief Check if the library exports the batched function.
+    //!------------------------------------------------------------------------
+    bool isBatched()
+    {
+        return (m_library.getSymbol<Scalar>(m_name) != nullptr) &&
+               (resolve() != nullptr);
+    }
+
+    //!------------------------------------------------------------------------
+    //! \brief Get the number of pending calls.
+    //!------------------------------------------------------------------------
+    std::size_t pending() const
+    {
+        return m_size;
+    }
+
+private:
+
+    //! \brief Size of an array of the batch, rounded up to the alignment
+    template <typename T>
+    static constexpr std::size_t arraySize()
+    {
+        return (sizeof(T) * BATCH + ALIGNMENT - 1u) & ~(ALIGNMENT - 1u);
+    }
+
+    //! \brief Carve the aligned arrays out of a single allocation
+    void allocate()
+    {
+        const std::size_t sizes[] = { arraySize<Args>()..., 0u };
+        std::size_t total = arraySize<Out>() + arraySize<Out*>();
+        for (std::size_t size : sizes)
+        {
+            total += size;
+        }
+        // No aligned operator new before C++17
+        m_memory.reset(new unsigned char[total + ALIGNMENT - 1u]);
+        std::uintptr_t address =
+            reinterpret_cast<std::uintptr_t>(m_memory.get());
+        unsigned char* next = m_memory.get() +
+                              ((ALIGNMENT - address % ALIGNMENT) % ALIGNMENT);
+
+        m_outputs = reinterpret_cast<Out*>(next);
+        next += arraySize<Out>();
+        m_results = reinterpret_cast<Out**>(next);
+        next += arraySize<Out*>();
+        m_inputs = std::tuple<Args*...>{ carve<Args>(next)... };
+    }
+
+    template <typename T>
+    static T* carve(unsigned char*& p_next)
+    {
+        T* array = reinterpret_cast<T*>(p_next);
+        p_next += arraySize<T>();
+        return array;
+    }
+
+    template <std::size_t... I>
+    void store(std::index_sequence<I...>, const Args&... p_args)
+    {
+        int expand[] = { 0, (std::get<I>(m_inputs)[m_size] = p_args, 0)... };
+        (void) expand;
+    }
+
+    template <std::size_t... I>
+    void run(Batch p_batch,
+             Scalar p_scalar,
+             std::index_sequence<I...>,
+             std::size_t p_count)
+    {
+        if (p_batch != nullptr)
+        {
+            p_batch(std::get<I>(m_inputs)..., m_outputs, p_count);
+            return;
+        }
+        for (std::size_t i = 0u; i < p_count; ++i)
+        {
+            m_outputs[i] = p_scalar(std::get<I>(m_inputs)[i]...);
+        }
+    }
+
+    //! \brief The batched function, looked up again after a reload only.
+    //! Its absence is not an error of the library.
+    Batch resolve()
+    {
+        const std::uint64_t generation = m_library.getLoadGeneration();
+        if (generation != m_generation)
+        {
+            m_batch = reinterpret_cast<Batch>(
+                m_library.findOptionalSymbol(m_batch_name));
+            m_generation = generation;
+        }
+        return m_batch;
+    }
+
+private:
+
+    DynamicLibrary& m_library;
+    const std::string m_name;
+    const std::string m_batch_name;
+    //! \brief Generation of the library m_batch was resolved in (0: never)
+    std::uint64_t m_generation = 0u;
+    Batch m_batch = nullptr;
+
+    std::unique_ptr<unsigned char[]> m_memory;
+    std::tuple<Args*...> m_inputs;
+    Out* m_outputs = nullptr;
+    Out** m_results = nullptr;
+    std::size_t m_size = 0u;
+};
+
+} // namespace dl
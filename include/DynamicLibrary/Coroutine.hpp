@@ -0,0 +1,231 @@
+#pragma once
+
+//! ***************************************************************************
+//! \brief C++20 coroutine add-on: awaitable load and reload.
+//!
+//! Header-only, on top of the C++14 core: the blocking part of the operation
+//! (dlopen(), constructors of the library...) runs on a dedicated loader
+//! thread and the awaiting coroutine is then resumed on the executor given
+//! by the caller, so that the threads of a coroutine executor never block:
+//!
+//!   bool loaded = co_await dl::loadAsync(library, path,
+//!                                        dl::AutoReload::Disabled, post);
+//! ***************************************************************************
+
+#if (__cplusplus < 202002L) || !__has_include(<coroutine>)
+#    error "DynamicLibrary/Coroutine.hpp requires C++20 coroutines"
+#endif
+
+#include "DynamicLibrary/DynamicLibrary.hpp"
+
+#include <condition_variable>
+#include <coroutine>
+#include <deque>
+#include <exception>
+#include <functional>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <utility>
+
+namespace dl
+{
+
+//! \brief Runs a task later, on a thread of its choice (same signature as
+//! EventExecutor)
+using Executor = std::function<void(std::function<void()>)>;
+
+//! ***************************************************************************
+//! \brief Thread of the process running the blocking operations of the
+//! awaitables, one at a time and in submission order.
+//! ***************************************************************************
+class LoaderThread
+{
+public:
+
+    //!------------------------------------------------------------------------
+    //! \brief The loader thread of the process, started on first use.
+    //!------------------------------------------------------------------------
+    static LoaderThread& instance()
+    {
+        static LoaderThread loader;
+        return loader;
+    }
+
+    //!------------------------------------------------------------------------
+    //! \brief Destructor. Run the pending tasks, then stop the thread.
+    //!------------------------------------------------------------------------
+    ~LoaderThread()
+    {
+        {
+            std::lock_guard<std::mutex> lock(m_mutex);
+            m_stop = true;
+        }
+        m_condition.notify_one();
+        m_thread.join();
+    }
+
+    LoaderThread(const LoaderThread&) = delete;
+    LoaderThread& operator=(const LoaderThread&) = delete;
+
+    //!------------------------------------------------------------------------
+    //! \brief Queue a task for the loader thread.
+    //!------------------------------------------------------------------------
+    void post(std::function<void()> p_task)
+    {
+        {
+            std::lock_guard<std::mutex> lock(m_mutex);
+            m_tasks.push_back(std::move(p_task));
+        }
+        m_condition.notify_one();
+    }
+
+private:
+
+    LoaderThread() : m_thread([this]() { run(); }) {}
+
+    void run()
+    {
+        std::unique_lock<std::mutex> lock(m_mutex);
+        for (;;)
+        {
+            m_condition.wait(lock,
+                             [this]() { return m_stop || !m_tasks.empty(); });
+            if (m_tasks.empty())
+            {
+                return;
+            }
+            std::function<void()> task = std::move(m_tasks.front());
+            m_tasks.pop_front();
+            lock.unlock();
+            task();
+            lock.lock();
+        }
+    }
+
+private:
+
+    std::mutex m_mutex;
+    std::condition_variable m_condition;
+    std::deque<std::function<void()>> m_tasks;
+    bool m_stop = false;
+    //! \brief Last: started once the other members are constructed
+    std::thread m_thread;
+};
+
+//! ***************************************************************************
+//! \brief Awaitable running a blocking operation on the loader thread and
+//! resuming the awaiting coroutine on an executor.
+//! \tparam Result Result of the operation, returned by co_await.
+//! ***************************************************************************
+template <typename Result>
+class LoaderAwaitable
+{
+public:
+
+    //!------------------------------------------------------------------------
+    //! \brief Constructor.
+    //! \param p_operation Blocking operation, run on the loader thread.
+    //! \param p_resume Executor resuming the coroutine (empty: resume it on
+    //!   the loader thread).
+    //!------------------------------------------------------------------------
+    LoaderAwaitable(std::function<Result()> p_operation, Executor p_resume)
+        : m_operation(std::move(p_operation)), m_resume(std::move(p_resume))
+    {
+    }
+
+    bool await_ready() const noexcept
+    {
+        return false;
+    }
+
+    void await_suspend(std::coroutine_handle<> p_caller)
+    {
+        // The awaitable lives in the frame of the suspended coroutine
+        LoaderThread::instance().post(
+            [this, p_caller]()
+            {
+                try
+                {
+                    m_result = m_operation();
+                }
+                catch (...)
+                {
+                    m_exception = std::current_exception();
+                }
+                // Once resumed, the coroutine may destroy the frame, and
+                // this awaitable with it, before the executor returns: the
+                // executor is moved out of it first.
+                Executor resume = std::move(m_resume);
+                if (resume)
+                {
+                    resume([p_caller]() { p_caller.resume(); });
+                }
+                else
+                {
+                    p_caller.resume();
+                }
+            });
+    }
+
+    Result await_resume()
+    {
+        if (m_exception)
+        {
+            std::rethrow_exception(m_exception);
+        }
+        return std::move(m_result);
+    }
+
+private:
+
+    std::function<Result()> m_operation;
+    Executor m_resume;
+    Result m_result{};
+    std::exception_ptr m_exception;
+};
+
+//!----------------------------------------------------------------------------
+//! \brief Awaitable version of DynamicLibrary::load().
+//! \param p_library Library to load, which must outlive the co_await.
+//! \param p_library_path Path to the library file.
+//! \param p_auto_reload Whether to enable automatic reloading.
+//! \param p_resume Executor resuming the awaiting coroutine (empty: resume
+//!   it on the loader thread).
+//! \param p_namespace Link-map namespace to load the library into.
+//! \return Awaitable of the result of load().
+//! \note The error message can be retrieved with getErrorMessage().
+//!----------------------------------------------------------------------------
+inline LoaderAwaitable<bool>
+loadAsync(DynamicLibrary& p_library,
+          std::string p_library_path,
+          AutoReload p_auto_reload,
+          Executor p_resume = {},
+          LinkNamespace p_namespace = LinkNamespace::Shared)
+{
+    return LoaderAwaitable<bool>(
+        [&p_library,
+         path = std::move(p_library_path),
+         p_auto_reload,
+         p_namespace]()
+        { return p_library.load(path, p_auto_reload, p_namespace); },
+        std::move(p_resume));
+}
+
+//!----------------------------------------------------------------------------
+//! \brief Awaitable version of DynamicLibrary::reload().
+//! \param p_library Library to reload, which must outlive the co_await.
+//! \param p_resume Executor resuming the awaiting coroutine (empty: resume
+//!   it on the loader thread).
+//! \return Awaitable of the result of reload().
+//! \note The error message can be retrieved with getErrorMessage().
+//!----------------------------------------------------------------------------
+inline LoaderAwaitable<bool> reloadAsync(DynamicLibrary& p_library,
+                                         Executor p_resume = {})
+{
+    return LoaderAwaitable<bool>([&p_library]()
+                                 { return p_library.reload(); },
+                                 std::move(p_resume));
+}
+
+} // namespace dl
@@ -1,9 +1,16 @@
 #pragma once
 
+#include "DynamicLibrary/PluginMetadata.hpp"
+
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
 #include <functional>
 #include <memory>
 #include <stdexcept>
 #include <string>
+#include <utility>
+#include <vector>
 
 namespace dl
 {
@@ -17,6 +24,210 @@ enum class AutoReload
     Enabled   //!< Auto-reload is enabled
 };
 
+//! ***************************************************************************
+//! \brief Enum class for huge page backing of the library code
+//! ***************************************************************************
+enum class HugePages
+{
+    Disabled, //!< Code stays mapped from the library file
+    Enabled   //!< Code is moved onto transparent huge pages when possible
+};
+
+//! ***************************************************************************
+//! \brief Enum class for the thread running the loader calls of a manager
+//! ***************************************************************************
+enum class LoaderService
+{
+    Disabled, //!< dlopen() and dlclose() run on the calling threads
+    Enabled   //!< They run on a thread of the manager, one at a time
+};
+
+//! ***************************************************************************
+//! \brief Enum class for the recording of the operation latencies
+//! ***************************************************************************
+enum class MetricsRecording
+{
+    Disabled, //!< No clock read nor counter update on the operations
+    Enabled   //!< Latencies are recorded for getMetrics()
+};
+
+//! ***************************************************************************
+//! \brief Enum class for the order of the calls of
+//! DynamicLibraryManager::invokeAll()
+//! ***************************************************************************
+enum class InvokeOrder
+{
+    Parallel,     //!< Calls run concurrently, in no particular order
+    Deterministic //!< Calls run one after another, in provider order
+};
+
+//! ***************************************************************************
+//! \brief Enum class for the link-map namespace the library is loaded into
+//! ***************************************************************************
+enum class LinkNamespace
+{
+    Shared,  //!< Default namespace shared with the application (dlopen)
+    Isolated //!< Private namespace created for this library (dlmopen)
+};
+
+//! ***************************************************************************
+//! \brief Memory cost of a link-map namespace
+//! ***************************************************************************
+struct NamespaceReport
+{
+    long id = 0;                  //!< Namespace identifier (0: base namespace)
+    std::string library;          //!< Library which owns the namespace
+    std::size_t objects = 0;      //!< Number of shared objects in the namespace
+    std::size_t mapped_bytes = 0; //!< Total size of their loaded segments
+};
+
+//! ***************************************************************************
+//! \brief Memory used by a loaded library
+//! ***************************************************************************
+struct MemoryFootprint
+{
+    std::size_t text = 0;     //!< Size of the executable segments
+    std::size_t rodata = 0;   //!< Size of the read-only data segments
+    std::size_t data = 0;     //!< Size of the initialized writable data
+    std::size_t bss = 0;      //!< Size of the zero-initialized data
+    std::size_t tls = 0;      //!< Size of the TLS block (per thread)
+    std::size_t resident = 0; //!< Resident memory of the mapped pages
+
+    MemoryFootprint& operator+=(const MemoryFootprint& p_other)
+    {
+        text += p_other.text;
+        rodata += p_other.rodata;
+        data += p_other.data;
+        bss += p_other.bss;
+        tls += p_other.tls;
+        resident += p_other.resident;
+        return *this;
+    }
+};
+
+//! ***************************************************************************
+//! \brief Histogram of the durations of an operation
+//! ***************************************************************************
+struct LatencyHistogram
+{
+    //! \brief Bucket i counts the durations in [2^i, 2^(i+1)) ns; the first
+    //! one also counts 0 ns and the last one everything above.
+    static constexpr std::size_t BUCKETS = 32u;
+
+    std::uint64_t count = 0;                   //!< Number of operations
+    std::uint64_t total_ns = 0;                //!< Sum of the durations
+    std::uint64_t buckets[BUCKETS] = {};       //!< Operations per bucket
+
+    LatencyHistogram& operator+=(const LatencyHistogram& p_other)
+    {
+        count += p_other.count;
+        total_ns += p_other.total_ns;
+        for (std::size_t i = 0u; i < BUCKETS; ++i)
+        {
+            buckets[i] += p_other.buckets[i];
+        }
+        return *this;
+    }
+};
+
+//! ***************************************************************************
+//! \brief Counters and latencies of the operations made on a library
+//! ***************************************************************************
+struct LibraryMetrics
+{
+    LatencyHistogram load;         //!< dlopen(), including those of reloads
+    LatencyHistogram lookup_hit;   //!< getSymbol() served by the cache
+    LatencyHistogram lookup_miss;  //!< getSymbol() going to dlsym()
+    LatencyHistogram reload;       //!< Reloads (unload, then load)
+    LatencyHistogram unload;       //!< dlclose()
+    LatencyHistogram reload_probe; //!< Test of the reload capability
+
+    LibraryMetrics& operator+=(const LibraryMetrics& p_other)
+    {
+        load += p_other.load;
+        lookup_hit += p_other.lookup_hit;
+        lookup_miss += p_other.lookup_miss;
+        reload += p_other.reload;
+        unload += p_other.unload;
+        reload_probe += p_other.reload_probe;
+        return *this;
+    }
+};
+
+//! ***************************************************************************
+//! \brief Events of the life of a library, see DynamicLibrary::subscribe()
+//! ***************************************************************************
+enum class LibraryEvent
+{
+    PreReload,    //!< The library is about to be unloaded for a reload
+    PostReload,   //!< The new build of the library is loaded
+    ReloadFailed, //!< The new build failed to load: the library is unloaded
+    Unloaded      //!< The library was unloaded, evicted or destroyed
+};
+
+//! ***************************************************************************
+//! \brief Event delivered to the subscribers of a library
+//! ***************************************************************************
+struct LibraryNotification
+{
+    LibraryEvent event = LibraryEvent::Unloaded;
+    std::string library;       //!< Name in the manager (empty if unmanaged)
+    std::string path;          //!< Path of the library
+    std::string error_message; //!< Cause of a ReloadFailed event
+    //! \brief Events lost since the previous delivery, the queue being full
+    std::size_t dropped = 0u;
+};
+
+//! \brief Subscriber to the events of libraries
+using EventCallback = std::function<void(const LibraryNotification&)>;
+//! \brief Runs a task later, on a thread of its choice (thread pool...)
+using EventExecutor = std::function<void(std::function<void()>)>;
+//! \brief Identifier of a subscription, 0 being never used
+using SubscriptionId = std::uint64_t;
+
+//! ***************************************************************************
+//! \brief Result of the call of a function of a library by
+//! DynamicLibraryManager::invokeAll()
+//! ***************************************************************************
+template <typename Result>
+struct InvokeResult
+{
+    std::string library; //!< Name of the library in the manager
+    Result value;        //!< Value returned by the function
+};
+
+template <>
+struct InvokeResult<void>
+{
+    std::string library; //!< Name of the library in the manager
+};
+
+//! ***************************************************************************
+//! \brief Handle on a library of a DynamicLibraryManager. Resolving it is an
+//! array access; a handle on an unloaded library stays invalid even if its
+//! slot is reused.
+//! ***************************************************************************
+struct LibraryHandle
+{
+    std::uint32_t index = 0;      //!< Slot of the library in the manager
+    std::uint32_t generation = 0; //!< Use count of the slot (0: no library)
+
+    bool isValid() const
+    {
+        return generation != 0u;
+    }
+
+    bool operator==(const LibraryHandle& p_other) const
+    {
+        return (index == p_other.index) && (generation == p_other.generation);
+    }
+
+    bool operator!=(const LibraryHandle& p_other) const
+    {
+        return !(*this == p_other);
+    }
+};
+
 //! ***************************************************************************
 //! \brief Exception class for DynamicLibrary errors
 //! ***************************************************************************
@@ -30,6 +241,9 @@ public:
     }
 };
 
+template <typename Signature, std::size_t BATCH>
+class BatchedFunction;
+
 //! ***************************************************************************
 //! \brief Class for managing dynamic library loading and symbol resolution.
 //! ***************************************************************************
@@ -46,10 +260,13 @@ public:
     //! \brief Constructor with automatic library loading.
     //! \param p_library_path Path to the library file.
     //! \param p_auto_reload Whether to enable automatic reloading.
+    //! \param p_namespace Link-map namespace to load the library into.
     //! \throw DynamicLibraryException If the library fails to load.
     //!------------------------------------------------------------------------
-    explicit DynamicLibrary(const std::string& p_library_path,
-                            AutoReload p_auto_reload);
+    explicit DynamicLibrary(
+        const std::string& p_library_path,
+        AutoReload p_auto_reload,
+        LinkNamespace p_namespace = LinkNamespace::Shared);
 
     //!------------------------------------------------------------------------
     //! \brief Destructor.
@@ -66,10 +283,53 @@ public:
     //! \brief Load a dynamic library.
     //! \param p_library_path Path to the library file.
     //! \param p_auto_reload Whether to enable automatic reloading.
+    //! \param p_namespace Link-map namespace to load the library into. With
+    //!   LinkNamespace::Isolated, two builds of the same library can be loaded
+    //!   side by side (Linux/glibc only).
     //! \return true if the library was loaded successfully, false otherwise.
     //! \note The error message can be retrieved with getErrorMessage().
+    //! \note On Linux, the file is opened once and its signature read from
+    //!   the descriptor. The library is loaded by its path ($ORIGIN, dladdr()
+    //!   and debuggers work as usual) and the load fails if the loaded object
+    //!   is not the opened file, replaced meanwhile.
     //!------------------------------------------------------------------------
-    bool load(const std::string& p_library_path, AutoReload p_auto_reload);
+    bool load(const std::string& p_library_path,
+              AutoReload p_auto_reload,
+              LinkNamespace p_namespace = LinkNamespace::Shared);
+
+    //!------------------------------------------------------------------------
+    //! \brief Register a dynamic library without loading it yet.
+    //! Only the path and the signature of the file are recorded: the library
+    //! is loaded on the first call to getSymbol(), once, even when several
+    //! threads ask for a symbol at the same time.
+    //! \param p_library_path Path to the library file.
+    //! \param p_auto_reload Whether to enable automatic reloading.
+    //! \param p_namespace Link-map namespace to load the library into.
+    //! \return true if the library file exists, false otherwise.
+    //! \note isLoaded() returns false until the library is actually loaded.
+    //! \note The error message can be retrieved with getErrorMessage().
+    //!------------------------------------------------------------------------
+    bool loadLazy(const std::string& p_library_path,
+                  AutoReload p_auto_reload,
+                  LinkNamespace p_namespace = LinkNamespace::Shared);
+
+    //!------------------------------------------------------------------------
+    //! \brief Load a dynamic library from a memory buffer.
+    //! The buffer is copied into an anonymous memory file (memfd) which is
+    //! loaded through its /proc/self/fd path: nothing is written on disk.
+    //! \param p_data Content of the shared object.
+    //! \param p_size Size of the buffer in bytes.
+    //! \param p_name Name given to the memory file (for debugging purposes).
+    //! \param p_namespace Link-map namespace to load the library into.
+    //! \return true if the library was loaded successfully, false otherwise.
+    //! \note Linux only. Auto-reload is disabled for such libraries since
+    //!   there is no file to watch: use reload(p_data, p_size) instead.
+    //! \note The error message can be retrieved with getErrorMessage().
+    //!------------------------------------------------------------------------
+    bool loadFromMemory(const void* p_data,
+                        std::size_t p_size,
+                        const std::string& p_name,
+                        LinkNamespace p_namespace = LinkNamespace::Shared);
 
     //!------------------------------------------------------------------------
     //! \brief Unload the current library.
@@ -78,9 +338,21 @@ public:
     //!------------------------------------------------------------------------
     bool unload();
 
+    //!------------------------------------------------------------------------
+    //! \brief Unload the library but keep it registered: it is loaded again
+    //! transparently by the next getSymbol(), as with loadLazy().
+    //! \return true if the library was evicted, false otherwise (not loaded,
+    //!   loaded from memory or not reloadable).
+    //! \warning Symbols obtained before the eviction become dangling.
+    //! \note The error message can be retrieved with getErrorMessage().
+    //!------------------------------------------------------------------------
+    bool evict();
+
     //!------------------------------------------------------------------------
     //! \brief Check if a library is currently loaded.
     //! \return true if a library is loaded, false otherwise.
+    //! \note Lock-free: never waits for a load or a reload in progress,
+    //!   whose result is seen once it completes.
     //!------------------------------------------------------------------------
     bool isLoaded() const;
 
@@ -113,6 +385,8 @@ public:
     //!------------------------------------------------------------------------
     //! \brief Check if the library has been updated.
     //! \return true if the library has been modified since last load.
+    //! \note Does not wait for a load or a reload in progress: the file is
+    //!   compared with the last completed one.
     //!------------------------------------------------------------------------
     bool checkForUpdates() const;
 
@@ -123,12 +397,40 @@ public:
     //!------------------------------------------------------------------------
     bool reload();
 
+    //!------------------------------------------------------------------------
+    //! \brief Replace the library by a new build held in memory.
+    //! \param p_data Content of the new shared object.
+    //! \param p_size Size of the buffer in bytes.
+    //! \return true if the library was reloaded successfully, false otherwise.
+    //! \note The error message can be retrieved with getErrorMessage().
+    //!------------------------------------------------------------------------
+    bool reload(const void* p_data, std::size_t p_size);
+
     //!------------------------------------------------------------------------
     //! \brief Enable or disable automatic reloading.
     //! \param p_enable Whether to enable automatic reloading.
     //!------------------------------------------------------------------------
     void setAutoReload(AutoReload p_enable = AutoReload::Enabled);
 
+    //!------------------------------------------------------------------------
+    //! \brief Move the code of the library onto transparent huge pages.
+    //! Applied by the following loads and reloads: the 2 MiB aligned part of
+    //! each executable segment is remapped onto huge-page-backed memory to
+    //! reduce iTLB misses on large hot code. Silently skipped when the kernel
+    //! does not allow it or when the segments are too small.
+    //! \param p_enable Whether to enable huge page backing.
+    //! \note Linux only. The remapped code is anonymous memory: it is no
+    //!   longer shared with other processes and profilers may lose the file
+    //!   association of these addresses.
+    //!------------------------------------------------------------------------
+    void setHugePageText(HugePages p_enable = HugePages::Enabled);
+
+    //!------------------------------------------------------------------------
+    //! \brief Get the size of the code moved onto huge pages.
+    //! \return Number of bytes remapped by the last load (0 if none).
+    //!------------------------------------------------------------------------
+    std::size_t getHugePageTextSize() const;
+
     //!------------------------------------------------------------------------
     //! \brief Check if the library can be reloaded.
     //! \return true if the library can be safely reloaded.
@@ -139,15 +441,143 @@ public:
     //!------------------------------------------------------------------------
     //! \brief Get the path of the currently loaded library.
     //! \return The library path.
+    //! \note Lock-free: never waits for a load or a reload in progress,
+    //!   whose result is seen once it completes.
     //!------------------------------------------------------------------------
     std::string getPath() const;
 
     //!------------------------------------------------------------------------
     //! \brief Get the error message.
     //! \return The error message.
+    //! \note Lock-free: never waits for a load or a reload in progress,
+    //!   whose result is seen once it completes.
     //!------------------------------------------------------------------------
     std::string getErrorMessage() const;
 
+    //!------------------------------------------------------------------------
+    //! \brief Get the GNU build-id of the loaded library.
+    //! The build-id identifies the content of the binary: when the file is
+    //! modified but still holds the same build-id (e.g. bit-identical relink),
+    //! checkForUpdates() reports no update and the automatic reload does not
+    //! happen: only the new file signature is recorded. An explicit reload()
+    //! or touch() always reloads.
+    //! \return The build-id in hexadecimal, or an empty string if the library
+    //!   is not loaded or has no build-id (Linux only).
+    //!------------------------------------------------------------------------
+    std::string getBuildId() const;
+
+    //!------------------------------------------------------------------------
+    //! \brief Get the time of the last load or getSymbol() call.
+    //!------------------------------------------------------------------------
+    std::chrono::steady_clock::time_point getLastUse() const;
+
+    //!------------------------------------------------------------------------
+    //! \brief Get the generation of the loaded code, which changes at each
+    //! load, reload and unload: the symbols obtained under another
+    //! generation are no longer valid.
+    //! \note Lock-free.
+    //!------------------------------------------------------------------------
+    std::uint64_t getLoadGeneration() const;
+
+    //!------------------------------------------------------------------------
+    //! \brief Get the size of the loadable segments of the library.
+    //! \return Mapped size in bytes (0 if not loaded or not supported).
+    //!------------------------------------------------------------------------
+    std::size_t getMappedSize() const;
+
+    //!------------------------------------------------------------------------
+    //! \brief Get the memory used by the library.
+    //! Segment sizes come from the program headers of the loaded object and
+    //! the resident memory from /proc/self/smaps (Linux only).
+    //! \return The memory footprint (zero if the library is not loaded).
+    //!------------------------------------------------------------------------
+    MemoryFootprint getMemoryFootprint() const;
+
+    //!------------------------------------------------------------------------
+    //! \brief Get the link-map namespace the library is loaded into.
+    //! \return The namespace identifier (0 for the base namespace).
+    //!------------------------------------------------------------------------
+    long getNamespaceId() const;
+
+    //!------------------------------------------------------------------------
+    //! \brief Get the memory cost of the namespace the library lives in.
+    //! \return The namespace report (empty if the library is not loaded).
+    //!------------------------------------------------------------------------
+    NamespaceReport getNamespaceReport() const;
+
+    //!------------------------------------------------------------------------
+    //! \brief Get the latency histograms of the operations made on the
+    //! library since its creation.
+    //! \note Recording costs two clock reads and a few relaxed atomic
+    //! increments on a per-thread shard; the snapshot merges the shards.
+    //! It can be turned off with setMetricsRecording().
+    //!------------------------------------------------------------------------
+    LibraryMetrics getMetrics() const;
+
+    //!------------------------------------------------------------------------
+    //! \brief Record the latencies of the operations (the default) or not,
+    //! for example to keep getSymbol() hits as cheap as possible.
+    //! \param p_mode Whether to record the latencies.
+    //!------------------------------------------------------------------------
+    void setMetricsRecording(
+        MetricsRecording p_mode = MetricsRecording::Enabled);
+
+    //!------------------------------------------------------------------------
+    //! \brief Subscribe to the events of the library (see LibraryEvent).
+    //! The reload path only pushes the events into a bounded lock-free
+    //! queue: the callbacks are called by dispatchEvents(), or by the tasks
+    //! given to the executor set by setEventExecutor(). Events happening
+    //! while nobody is subscribed are not queued.
+    //! \param p_callback Called once per event, in the order of the events.
+    //! \return Identifier of the subscription, for unsubscribe().
+    //!------------------------------------------------------------------------
+    SubscriptionId subscribe(EventCallback p_callback);
+
+    //!------------------------------------------------------------------------
+    //! \brief Cancel a subscription made with subscribe().
+    //! \param p_id Identifier of the subscription.
+    //!------------------------------------------------------------------------
+    void unsubscribe(SubscriptionId p_id);
+
+    //!------------------------------------------------------------------------
+    //! \brief Deliver the events through an executor rather than through
+    //! dispatchEvents(). The executor is given a task whenever events are
+    //! queued and no task is pending yet; the task delivers them.
+    //! \param p_executor Executor (empty to go back to dispatchEvents()).
+    //! \note The executor is called on the reload path once the lock of the
+    //!   library is released: an inline executor (running the task at once)
+    //!   is allowed, but delays the caller of reload() by the callbacks.
+    //!------------------------------------------------------------------------
+    void setEventExecutor(EventExecutor p_executor);
+
+    //!------------------------------------------------------------------------
+    //! \brief Deliver the queued events to the subscribers, on the calling
+    //! thread.
+    //! \return Number of delivered events.
+    //! \note Must not be called from a subscriber.
+    //!------------------------------------------------------------------------
+    std::size_t dispatchEvents();
+
+    //!------------------------------------------------------------------------
+    //! \brief Limit the number of isolated namespaces alive in the process.
+    //! \param p_max Maximum number of isolated namespaces. glibc supports at
+    //!   most 15 of them, and fewer when they exhaust the static TLS block.
+    //!------------------------------------------------------------------------
+    static void setMaxIsolatedNamespaces(std::size_t p_max);
+
+    //!------------------------------------------------------------------------
+    //! \brief Persist the resolved symbols across restarts.
+    //! When a library is unloaded, its resolved symbols are saved as offsets
+    //! from its load base in "<directory>/<build-id>.symbols", keyed by the
+    //! GNU build-id of the ELF file. The next load of the same build fills
+    //! its symbol cache from this file instead of calling dlsym(); a
+    //! different build-id ignores it.
+    //! \param p_directory Existing directory for the cache files (empty to
+    //!   disable the persistent cache, the default).
+    //! \note Linux only. Libraries without build-id are never cached.
+    //!------------------------------------------------------------------------
+    static void setSymbolCacheDirectory(const std::string& p_directory);
+
     //!------------------------------------------------------------------------
     //! \brief Update the library's modification timestamp.
     //! \return true if the timestamp was updated successfully, false otherwise.
@@ -164,8 +594,22 @@ private:
     //!------------------------------------------------------------------------
     void* getSymbolInternal(const std::string& p_symbol_name);
 
+    //!------------------------------------------------------------------------
+    //! \brief Look up a symbol the library may not export, in the loaded
+    //! build only. A missing symbol is not an error: the error message and
+    //! the lookup metrics are left untouched.
+    //! \param p_symbol_name Name of the symbol to retrieve.
+    //! \return Raw pointer to the symbol, nullptr if not exported or if the
+    //!   library is not loaded.
+    //!------------------------------------------------------------------------
+    void* findOptionalSymbol(const std::string& p_symbol_name);
+
 private:
 
+    friend class DynamicLibraryManager;
+    template <typename Signature, std::size_t BATCH>
+    friend class BatchedFunction;
+
     class Implementation;
     std::unique_ptr<Implementation> m_impl;
 };
@@ -178,45 +622,457 @@ class DynamicLibraryManager
 public:
 
     //!------------------------------------------------------------------------
-    //! \brief Constructor.
+    //! \brief Constructor. On Linux, start the thread watching (with a
+    //! single inotify instance) the directories of the managed libraries and
+    //! the search paths. Watched libraries are notified of the changes of
+    //! their file, so checking them for updates does not stat the file.
     //!------------------------------------------------------------------------
     DynamicLibraryManager() noexcept;
 
     //!------------------------------------------------------------------------
-    //! \brief Destructor.
+    //! \brief Destructor. Stop the watcher thread.
     //!------------------------------------------------------------------------
     ~DynamicLibraryManager();
 
     //!------------------------------------------------------------------------
     //! \brief Load a library and store it in the manager.
     //! \param p_name Name to associate with the library.
-    //! \param p_path Path to the library file.
+    //! \param p_path Path to the library file. A short name without
+    //!   directory (i.e. "foo") is first resolved through the search paths.
     //! \param p_auto_reload Whether to enable automatic reloading.
+    //! \param p_namespace Link-map namespace to load the library into.
     //! \return Shared pointer to the loaded library.
+    //! \note The manager is not locked during the load itself: libraries of
+    //!   other names load concurrently, and a concurrent load of the same
+    //!   name waits for this one then returns its library.
+    //!------------------------------------------------------------------------
+    std::shared_ptr<DynamicLibrary>
+    loadLibrary(const std::string& p_name,
+                const std::string& p_path,
+                AutoReload p_auto_reload,
+                LinkNamespace p_namespace = LinkNamespace::Shared);
+
+    //!------------------------------------------------------------------------
+    //! \brief Same as loadLibrary(), also giving the handle of the library,
+    //! so that it can be resolved by getLibrary(LibraryHandle) without ever
+    //! hashing its name.
+    //! \param p_handle Receives the handle of the library.
+    //!------------------------------------------------------------------------
+    std::shared_ptr<DynamicLibrary>
+    loadLibrary(const std::string& p_name,
+                const std::string& p_path,
+                AutoReload p_auto_reload,
+                LibraryHandle& p_handle,
+                LinkNamespace p_namespace = LinkNamespace::Shared);
+
+    //!------------------------------------------------------------------------
+    //! \brief Register a library in the manager without loading it.
+    //! The library is loaded on its first getSymbol() (see
+    //! DynamicLibrary::loadLazy()), which saves boot time and memory for
+    //! plugins that are rarely used.
+    //! \param p_name Name to associate with the library.
+    //! \param p_path Path or short name of the library file.
+    //! \param p_auto_reload Whether to enable automatic reloading.
+    //! \param p_namespace Link-map namespace to load the library into.
+    //! \return Shared pointer to the registered library.
+    //! \throw DynamicLibraryException If the library file does not exist.
     //!------------------------------------------------------------------------
-    std::shared_ptr<DynamicLibrary> loadLibrary(const std::string& p_name,
-                                                const std::string& p_path,
-                                                AutoReload p_auto_reload);
+    std::shared_ptr<DynamicLibrary>
+    registerLibrary(const std::string& p_name,
+                    const std::string& p_path,
+                    AutoReload p_auto_reload,
+                    LinkNamespace p_namespace = LinkNamespace::Shared);
+
+    //!------------------------------------------------------------------------
+    //! \brief Same as registerLibrary(), also giving the handle of the
+    //! library (see getLibrary(LibraryHandle)).
+    //! \param p_handle Receives the handle of the library.
+    //!------------------------------------------------------------------------
+    std::shared_ptr<DynamicLibrary>
+    registerLibrary(const std::string& p_name,
+                    const std::string& p_path,
+                    AutoReload p_auto_reload,
+                    LibraryHandle& p_handle,
+                    LinkNamespace p_namespace = LinkNamespace::Shared);
+
+    //!------------------------------------------------------------------------
+    //! \brief Append a directory to the ordered list of search paths.
+    //! The directory is listed once and then kept up to date from change
+    //! notifications (inotify on Linux), so resolving a name never touches
+    //! the file system. A directory which does not exist yet, or which is
+    //! deleted or moved, is watched again once it is back (checked at most
+    //! once per second).
+    //! \param p_directory Directory containing libraries.
+    //!------------------------------------------------------------------------
+    void addSearchPath(const std::string& p_directory);
+
+    //!------------------------------------------------------------------------
+    //! \brief Resolve a short library name through the search paths.
+    //! "foo" matches the files "foo", "libfoo.so" and "foo.so" (with the
+    //! platform extension), in this order, in the first search path holding
+    //! one of them.
+    //! \param p_name Short name of the library.
+    //! \return Path of the library, or an empty string if not found.
+    //!------------------------------------------------------------------------
+    std::string resolve(const std::string& p_name);
+
+    //!------------------------------------------------------------------------
+    //! \brief Load all the libraries of a plugin archive (see PluginArchive).
+    //! Each entry is loaded from the memory-mapped archive under the name
+    //! stored in the index. When the same archive is loaded again after an
+    //! update, only the entries whose hash has changed are reloaded.
+    //! The update is atomic: all the entries are checked, then the new
+    //! builds are loaded next to the current ones, which are only replaced
+    //! once every new build is loaded.
+    //! \param p_path Path to the archive file.
+    //! \return Number of libraries loaded or reloaded.
+    //! \throw DynamicLibraryException If the archive cannot be read, one of
+    //!   its entries is invalid or named after a library not loaded from an
+    //!   archive, or one of its libraries fails to load. The manager is then
+    //!   left untouched.
+    //!------------------------------------------------------------------------
+    std::size_t loadArchive(const std::string& p_path);
+
+    //!------------------------------------------------------------------------
+    //! \brief List the plugins of a directory from their metadata note (see
+    //! DL_PLUGIN_METADATA), without loading them. The candidate files (with
+    //! the platform library extension) are read in parallel, on the pool of
+    //! the manager (see invokeAll()).
+    //! \param p_directory Directory holding the plugins.
+    //! \param p_index_path Optional index file keeping the metadata and the
+    //!   signature of each file between runs: only the files whose signature
+    //!   changed are read again, and the index is rewritten if anything
+    //!   changed. Empty: no index.
+    //! \return Metadata of the files holding a note, sorted by path.
+    //!------------------------------------------------------------------------
+    std::vector<PluginMetadata>
+    discoverPlugins(const std::string& p_directory,
+                    const std::string& p_index_path = std::string()) const;
 
     //!------------------------------------------------------------------------
     //! \brief Unload a library from the manager.
+    //! The library is removed from the manager at once, but it is only
+    //! unloaded when the last shared pointer on it is released, so threads
+    //! still calling into it are not affected.
     //! \param p_name Name of the library to unload.
     //!------------------------------------------------------------------------
     void unloadLibrary(const std::string& p_name);
 
     //!------------------------------------------------------------------------
     //! \brief Get a library from the manager.
+    //! The lookup takes no lock and can be made concurrently from any number
+    //! of threads while libraries are loaded and unloaded.
     //! \param p_name Name of the library to retrieve.
     //! \return Shared pointer to the library, or nullptr if not found.
     //!------------------------------------------------------------------------
     std::shared_ptr<DynamicLibrary> getLibrary(const std::string& p_name);
 
+    //!------------------------------------------------------------------------
+    //! \brief Get the handle of a library, to be resolved by
+    //! getLibrary(LibraryHandle) on hot paths instead of hashing its name.
+    //! \param p_name Name of the library.
+    //! \return Handle of the library, invalid if the name is unknown.
+    //!------------------------------------------------------------------------
+    LibraryHandle getHandle(const std::string& p_name) const;
+
+    //!------------------------------------------------------------------------
+    //! \brief Get a library from its handle, without lock nor allocation.
+    //! \param p_handle Handle returned by getHandle(), loadLibrary() or
+    //!   registerLibrary().
+    //! \return Shared pointer to the library, or nullptr if the library has
+    //!   been unloaded from the manager since the handle was taken.
+    //! \note Only waits while the manager evicts this very library (see
+    //!   setMemoryBudget()), so that it is never evicted once given out.
+    //!------------------------------------------------------------------------
+    std::shared_ptr<DynamicLibrary> getLibrary(LibraryHandle p_handle) const;
+
+    //!------------------------------------------------------------------------
+    //! \brief Find the library which provides a symbol. The manager keeps an
+    //! index of the symbols exported by its libraries, updated incrementally
+    //! when libraries are loaded, reloaded or unloaded: the lookup is a hash
+    //! table access and takes no library lock.
+    //! \param p_symbol_name Name of the exported symbol.
+    //! \return The provider of highest priority (see setProviderPriority()),
+    //!   or nullptr if no managed library exports the symbol.
+    //! \note The index is only available on Linux. It is refreshed by the
+    //!   changes of the libraries of this manager only. Libraries registered
+    //!   with registerLibrary() export nothing until their first load (e.g.
+    //!   by a getSymbol() on them); evicted ones stay indexed.
+    //!------------------------------------------------------------------------
+    std::shared_ptr<DynamicLibrary>
+    findProvider(const std::string& p_symbol_name);
+
+    //!------------------------------------------------------------------------
+    //! \brief Get all the libraries which provide a symbol.
+    //! \param p_symbol_name Name of the exported symbol.
+    //! \return Names of the providers, by decreasing priority.
+    //!------------------------------------------------------------------------
+    std::vector<std::string> findProviders(const std::string& p_symbol_name);
+
+    //!------------------------------------------------------------------------
+    //! \brief Get a symbol from the library which provides it.
+    //! \tparam T Type of the symbol.
+    //! \param p_symbol_name Name of the exported symbol.
+    //! \return The symbol, or nullptr if no managed library exports it.
+    //!------------------------------------------------------------------------
+    template <typename T>
+    T findSymbol(const std::string& p_symbol_name)
+    {
+        auto library = findProvider(p_symbol_name);
+        return library ? library->getSymbol<T>(p_symbol_name) : nullptr;
+    }
+
+    //!------------------------------------------------------------------------
+    //! \brief Set the priority of a library as a symbol provider. When
+    //! several libraries export a symbol, the one with the highest priority
+    //! is returned by findProvider(), then the first by name.
+    //! \param p_name Name of the library in the manager.
+    //! \param p_priority Priority (default: 0).
+    //!------------------------------------------------------------------------
+    void setProviderPriority(const std::string& p_name, int p_priority);
+
+    //!------------------------------------------------------------------------
+    //! \brief Call a function in all the managed libraries exporting it.
+    //! The providers of the function (see findProviders()) and the addresses
+    //! of the function are resolved once, then reused until a library is
+    //! loaded, reloaded or unloaded. Parallel calls run on a work-stealing
+    //! pool of the manager, started on first use, which the calling thread
+    //! joins until all the calls are done.
+    //! \tparam Func Function type, e.g. int(double).
+    //! \param p_function_name Name of the exported function.
+    //! \param p_order Whether the calls may run concurrently.
+    //! \param p_args Arguments given to each call (shared by the calls).
+    //! \return One result per provider, by decreasing provider priority then
+    //!   by name, whatever the order of the calls.
+    //! \note The libraries are not checked for updates (see
+    //!   reloadUpdatedLibraries()). The first exception thrown by a call is
+    //!   rethrown once all the calls are done.
+    //! \note A library is not unloaded while one of its functions runs:
+    //!   reload(), unload() and the evictions wait for the call to return.
+    //!   The function may use its own library, e.g. getSymbol(), which then
+    //!   leaves the automatic reload to the next use; but reload(), touch(),
+    //!   evict() and unload() fail on it, and load(), loadLazy() and
+    //!   loadFromMemory() must not be called on it. Each call counts as a
+    //!   use of the library for the memory budget.
+    //!------------------------------------------------------------------------
+    template <typename Func, typename... Args>
+    std::vector<InvokeResult<typename std::function<Func>::result_type>>
+    invokeAll(const std::string& p_function_name,
+              InvokeOrder p_order,
+              Args&&... p_args)
+    {
+        using Result = typename std::function<Func>::result_type;
+        auto targets = resolveAll(p_function_name);
+        std::vector<InvokeResult<Result>> results(targets->size());
+        invokeEach(targets->size(),
+                   p_order,
+                   [&](std::size_t p_index)
+                   {
+                       const FunctionTarget& target = (*targets)[p_index];
+                       results[p_index].library = target.library;
+                       callTarget(target,
+                                  p_function_name,
+                                  [&](void* p_function)
+                                  {
+                                      call(results[p_index],
+                                           reinterpret_cast<Func*>(p_function),
+                                           p_args...);
+                                  });
+                   });
+        return results;
+    }
+
     //!------------------------------------------------------------------------
     //! \brief Check all managed libraries for updates.
     //! \return True if any library has updates, false otherwise.
     //!------------------------------------------------------------------------
     bool checkAllForUpdates();
 
+    //!------------------------------------------------------------------------
+    //! \brief Check all managed libraries for updates in one batch.
+    //! The library files are stat'ed in parallel on the pool of the manager
+    //! (see invokeAll()), without holding the manager lock.
+    //! \return Names of the libraries whose file has changed.
+    //!------------------------------------------------------------------------
+    std::vector<std::string> findUpdatedLibraries() const;
+
+    //!------------------------------------------------------------------------
+    //! \brief Reload the libraries reported by findUpdatedLibraries().
+    //! The other libraries are left untouched.
+    //! \return Names of the libraries successfully reloaded.
+    //!------------------------------------------------------------------------
+    std::vector<std::string> reloadUpdatedLibraries();
+
+    //!------------------------------------------------------------------------
+    //! \brief Run the dlopen() and dlclose() calls of the managed libraries
+    //! on a dedicated thread. Threads loading, reloading or unloading a
+    //! library at the same time then wait on a future instead of convoying
+    //! on the global lock of the dynamic loader; the requests queued while
+    //! the thread is busy are taken as one batch.
+    //! \param p_mode Whether to use the loader thread.
+    //! \note Constructors and destructors of the libraries run on the loader
+    //!   thread. A constructor may call the manager, which is not locked
+    //!   during the load, but not to load or unload its own library. A
+    //!   destructor must not call the load and unload functions of the
+    //!   manager, since evictions unload libraries under its lock.
+    //!------------------------------------------------------------------------
+    void setLoaderService(LoaderService p_mode = LoaderService::Enabled);
+
+    //!------------------------------------------------------------------------
+    //! \brief Limit the memory mapped by the managed libraries.
+    //! When the total mapped size exceeds the budget, the least recently used
+    //! libraries which are idle and reloadable are evicted (see
+    //! DynamicLibrary::evict()) and loaded again on their next use.
+    //! A library is never evicted while a shared_ptr to it is held outside
+    //! of the manager, nor by the loadLibrary() call loading it.
+    //! \param p_bytes Budget in bytes (0: no limit).
+    //! \param p_min_idle Minimum time without use before a library can be
+    //!   evicted. It protects the function pointers obtained from a library
+    //!   whose shared_ptr was released: with 0, a library used just before
+    //!   can be evicted.
+    //! \note The budget is enforced when a library is loaded and when
+    //!   enforceMemoryBudget() is called.
+    //!------------------------------------------------------------------------
+    void setMemoryBudget(
+        std::size_t p_bytes,
+        std::chrono::milliseconds p_min_idle = std::chrono::seconds(1));
+
+    //!------------------------------------------------------------------------
+    //! \brief Evict idle libraries until the memory budget is respected.
+    //! \return Number of evicted libraries.
+    //!------------------------------------------------------------------------
+    std::size_t enforceMemoryBudget();
+
+    //!------------------------------------------------------------------------
+    //! \brief Get the memory used by all the managed libraries.
+    //! /proc/self/smaps is read once for all the libraries.
+    //! \return Sum of the memory footprints of the loaded libraries.
+    //!------------------------------------------------------------------------
+    MemoryFootprint getMemoryFootprint() const;
+
+    //!------------------------------------------------------------------------
+    //! \brief Get the memory cost of each namespace used by the libraries.
+    //! \return One report per distinct link-map namespace.
+    //!------------------------------------------------------------------------
+    std::vector<NamespaceReport> getNamespaceReport() const;
+
+    //!------------------------------------------------------------------------
+    //! \brief Get the metrics of all the managed libraries.
+    //! \return Pairs of library name and metrics, sorted by name.
+    //!------------------------------------------------------------------------
+    std::vector<std::pair<std::string, LibraryMetrics>> getMetrics() const;
+
+    //!------------------------------------------------------------------------
+    //! \brief Record the latencies of the operations of the managed
+    //! libraries, present and future, or not (see
+    //! DynamicLibrary::setMetricsRecording()).
+    //! \param p_mode Whether to record the latencies.
+    //!------------------------------------------------------------------------
+    void setMetricsRecording(
+        MetricsRecording p_mode = MetricsRecording::Enabled);
+
+    //!------------------------------------------------------------------------
+    //! \brief Write the metrics of all the managed libraries to a file, in the
+    //! Prometheus text exposition format (dl_operation_duration_seconds
+    //! histogram labelled by library and operation).
+    //! \param p_path Path of the file, replaced atomically.
+    //! \return true on success.
+    //!------------------------------------------------------------------------
+    bool dumpMetrics(const std::string& p_path) const;
+
+    //!------------------------------------------------------------------------
+    //! \brief Subscribe to the events of all the managed libraries, named
+    //! in LibraryNotification::library. Delivery works as for
+    //! DynamicLibrary::subscribe(), with a queue shared by the libraries.
+    //! \param p_callback Called once per event, in the order of the events.
+    //! \return Identifier of the subscription, for unsubscribe().
+    //! \note Libraries removed by unloadLibrary() but still referenced keep
+    //!   reporting their events, up to their Unloaded event.
+    //!------------------------------------------------------------------------
+    SubscriptionId subscribe(EventCallback p_callback);
+
+    //!------------------------------------------------------------------------
+    //! \brief Cancel a subscription made with subscribe().
+    //! \param p_id Identifier of the subscription.
+    //!------------------------------------------------------------------------
+    void unsubscribe(SubscriptionId p_id);
+
+    //!------------------------------------------------------------------------
+    //! \brief Deliver the events through an executor rather than through
+    //! dispatchEvents(), see DynamicLibrary::setEventExecutor().
+    //! \param p_executor Executor (empty to go back to dispatchEvents()).
+    //!------------------------------------------------------------------------
+    void setEventExecutor(EventExecutor p_executor);
+
+    //!------------------------------------------------------------------------
+    //! \brief Deliver the queued events to the subscribers, on the calling
+    //! thread.
+    //! \return Number of delivered events.
+    //! \note Must not be called from a subscriber.
+    //!------------------------------------------------------------------------
+    std::size_t dispatchEvents();
+
+private:
+
+    //!------------------------------------------------------------------------
+    //! \brief Function exported by a managed library, for invokeAll()
+    //!------------------------------------------------------------------------
+    struct FunctionTarget
+    {
+        std::string library;
+        std::shared_ptr<DynamicLibrary> owner; //!< Keeps the library alive
+        void* function;
+        //! \brief DynamicLibrary::getLoadGeneration() of the address
+        std::uint64_t load_generation;
+    };
+
+    //!------------------------------------------------------------------------
+    //! \brief Resolve a function in all its providers, cached until the next
+    //! load, reload or unload.
+    //! \param p_function_name Name of the exported function.
+    //! \return The providers exporting it, by decreasing priority.
+    //!------------------------------------------------------------------------
+    std::shared_ptr<const std::vector<FunctionTarget>>
+    resolveAll(const std::string& p_function_name);
+
+    //!------------------------------------------------------------------------
+    //! \brief Call a resolved function. The library cannot be unloaded during
+    //! the call; a function made stale by a reload or an eviction since its
+    //! resolution is resolved again first.
+    //! \param p_target Function to call.
+    //! \param p_function_name Name of the function.
+    //! \param p_call Call of the address of the function.
+    //! \throw DynamicLibraryException if the function is no longer exported.
+    //!------------------------------------------------------------------------
+    void callTarget(const FunctionTarget& p_target,
+                    const std::string& p_function_name,
+                    const std::function<void(void*)>& p_call);
+
+    //!------------------------------------------------------------------------
+    //! \brief Call p_task(i) for i in [0, p_count).
+    //! \param p_count Number of calls.
+    //! \param p_order Run on the pool, or in order on the calling thread.
+    //! \param p_task Call to make.
+    //!------------------------------------------------------------------------
+    void invokeEach(std::size_t p_count,
+                    InvokeOrder p_order,
+                    const std::function<void(std::size_t)>& p_task);
+
+    //! \brief Call a function and store its result
+    template <typename Result, typename Function, typename... Args>
+    static void call(InvokeResult<Result>& p_result,
+                     Function* p_function,
+                     Args&... p_args)
+    {
+        p_result.value = p_function(p_args...);
+    }
+
+    template <typename Function, typename... Args>
+    static void call(InvokeResult<void>&, Function* p_function, Args&... p_args)
+    {
+        p_function(p_args...);
+    }
+
 private:
 
     class Implementation;
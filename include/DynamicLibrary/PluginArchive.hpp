@@ -0,0 +1,124 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <string>
+#include <utility>
+#include <vector>
+
+namespace dl
+{
+
+//! ***************************************************************************
+//! \brief Single-file container of shared libraries.
+//!
+//! Layout of an archive (native endianness):
+//!   - a header: magic "DLPLUGA", format version, number of entries and
+//!     alignment of the blobs;
+//!   - the index: one fixed-size record per entry holding its name, the
+//!     offset and size of its blob and a FNV-1a 64 hash of its content;
+//!   - the blobs, each one starting on an alignment boundary.
+//!
+//! The archive is memory-mapped when opened: entries are looked up through
+//! the index and their content is read straight from the mapping.
+//! ***************************************************************************
+class PluginArchive
+{
+public:
+
+    //!------------------------------------------------------------------------
+    //! \brief Description of a library stored in the archive.
+    //!------------------------------------------------------------------------
+    struct Entry
+    {
+        std::string name;       //!< Name of the library
+        std::uint64_t offset;   //!< Offset of the blob in the archive
+        std::uint64_t size;     //!< Size of the blob in bytes
+        std::uint64_t hash;     //!< FNV-1a 64 hash of the blob
+    };
+
+    //!------------------------------------------------------------------------
+    //! \brief Default constructor. Nothing is opened.
+    //!------------------------------------------------------------------------
+    PluginArchive() noexcept;
+
+    //!------------------------------------------------------------------------
+    //! \brief Destructor. Unmap the archive.
+    //!------------------------------------------------------------------------
+    ~PluginArchive();
+
+    // Non-copyable but movable
+    PluginArchive(const PluginArchive&) = delete;
+    PluginArchive& operator=(const PluginArchive&) = delete;
+    PluginArchive(PluginArchive&& p_other) noexcept;
+    PluginArchive& operator=(PluginArchive&& p_other) noexcept;
+
+    //!------------------------------------------------------------------------
+    //! \brief Write an archive from a list of library files.
+    //! \param p_archive_path Path of the archive to create. The file is
+    //!   replaced atomically so processes mapping the previous version are
+    //!   not disturbed.
+    //! \param p_libraries List of (name, path of the library file).
+    //! \return true if the archive was written successfully, false otherwise.
+    //! \note The error message can be retrieved with getErrorMessage().
+    //!------------------------------------------------------------------------
+    bool create(
+        const std::string& p_archive_path,
+        const std::vector<std::pair<std::string, std::string>>& p_libraries);
+
+    //!------------------------------------------------------------------------
+    //! \brief Map an archive and read its index.
+    //! \param p_archive_path Path of the archive.
+    //! \return true if the archive was opened successfully, false otherwise.
+    //! \note The error message can be retrieved with getErrorMessage().
+    //!------------------------------------------------------------------------
+    bool open(const std::string& p_archive_path);
+
+    //!------------------------------------------------------------------------
+    //! \brief Unmap the archive.
+    //!------------------------------------------------------------------------
+    void close();
+
+    //!------------------------------------------------------------------------
+    //! \brief Check if an archive is currently mapped.
+    //!------------------------------------------------------------------------
+    bool isOpen() const;
+
+    //!------------------------------------------------------------------------
+    //! \brief Get the entries of the archive, in index order.
+    //!------------------------------------------------------------------------
+    const std::vector<Entry>& getEntries() const;
+
+    //!------------------------------------------------------------------------
+    //! \brief Look up an entry by name.
+    //! \param p_name Name of the library.
+    //! \return The entry, or nullptr if not found.
+    //!------------------------------------------------------------------------
+    const Entry* find(const std::string& p_name) const;
+
+    //!------------------------------------------------------------------------
+    //! \brief Get the content of an entry inside the mapping.
+    //! \param p_entry Entry returned by getEntries() or find().
+    //! \return Pointer to the first byte of the blob. It stays valid until
+    //!   the archive is closed.
+    //!------------------------------------------------------------------------
+    const void* getData(const Entry& p_entry) const;
+
+    //!------------------------------------------------------------------------
+    //! \brief Get the error message.
+    //!------------------------------------------------------------------------
+    std::string getErrorMessage() const;
+
+    //!------------------------------------------------------------------------
+    //! \brief Compute the hash stored in the index for a blob.
+    //!------------------------------------------------------------------------
+    static std::uint64_t hash(const void* p_data, std::size_t p_size);
+
+private:
+
+    class Implementation;
+    std::unique_ptr<Implementation> m_impl;
+};
+
+} // namespace dl
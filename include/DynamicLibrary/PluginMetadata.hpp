@@ -0,0 +1,81 @@
+#pragma once
+
+#include <cstdint>
+#include <string>
+#include <vector>
+
+//! ***************************************************************************
+//! \brief Metadata of a plugin, stored in an ELF note so that it can be read
+//! without loading the plugin (and so without running any of its code).
+//!
+//! The note lives in the ".note.dl.plugin" section, which the linker places
+//! in a PT_NOTE segment. Its owner name is DL_PLUGIN_NOTE_NAME, its type
+//! DL_PLUGIN_NOTE_TYPE and its descriptor holds four NUL-terminated strings:
+//! name, version, capabilities and required symbols (the last two being
+//! comma-separated lists).
+//! ***************************************************************************
+#define DL_PLUGIN_NOTE_NAME "DLPLUGIN"
+#define DL_PLUGIN_NOTE_TYPE 1u
+
+//!----------------------------------------------------------------------------
+//! \brief Embed the metadata note in a plugin. To be used once, at namespace
+//! scope, in one source file of the plugin, with string literals:
+//!   DL_PLUGIN_METADATA("example", "1.0.0", "math,print", "host_log")
+//! \note Expands to nothing on non-ELF platforms.
+//!----------------------------------------------------------------------------
+#if defined(__ELF__)
+#    define DL_PLUGIN_METADATA(p_name, p_version, p_capabilities, p_requires) \
+        DL_PLUGIN_METADATA_NOTE(p_name "\0" p_version "\0" p_capabilities    \
+                                       "\0" p_requires)
+#else
+#    define DL_PLUGIN_METADATA(p_name, p_version, p_capabilities, p_requires)
+#endif
+
+//! \brief Layout of an ELF note, with the owner name and descriptor padded
+//! to 4 bytes. Use DL_PLUGIN_METADATA() instead.
+#define DL_PLUGIN_METADATA_NOTE(p_desc)                                       \
+    namespace                                                                 \
+    {                                                                         \
+    struct DlPluginNote                                                       \
+    {                                                                         \
+        std::uint32_t name_size;                                              \
+        std::uint32_t desc_size;                                              \
+        std::uint32_t type;                                                   \
+        char name[(sizeof(DL_PLUGIN_NOTE_NAME) + 3u) & ~3u];                  \
+        char desc[(sizeof(p_desc) + 3u) & ~3u];                               \
+    };                                                                        \
+    __attribute__((section(".note.dl.plugin"), used, aligned(4)))             \
+    const DlPluginNote dl_plugin_note = { sizeof(DL_PLUGIN_NOTE_NAME),        \
+                                          sizeof(p_desc),                     \
+                                          DL_PLUGIN_NOTE_TYPE,                \
+                                          DL_PLUGIN_NOTE_NAME,                \
+                                          p_desc };                           \
+    }
+
+namespace dl
+{
+
+//! ***************************************************************************
+//! \brief Metadata of a plugin read from its ELF note
+//! ***************************************************************************
+struct PluginMetadata
+{
+    std::string path;                          //!< Path of the plugin file
+    std::string name;                          //!< Name of the plugin
+    std::string version;                       //!< Version of the plugin
+    std::vector<std::string> capabilities;     //!< What the plugin provides
+    std::vector<std::string> required_symbols; //!< What it needs from the host
+};
+
+//!----------------------------------------------------------------------------
+//! \brief Read the metadata note of a plugin file without loading it.
+//! The file is memory-mapped and only its ELF header, program headers and
+//! notes are touched.
+//! \param p_path Path to the plugin file.
+//! \param p_metadata Filled with the metadata on success.
+//! \return true if the file is an ELF object holding a metadata note.
+//!----------------------------------------------------------------------------
+bool readPluginMetadata(const std::string& p_path,
+                        PluginMetadata& p_metadata);
+
+} // namespace dl
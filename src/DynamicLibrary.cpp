@@ -1,20 +1,46 @@
 #include "DynamicLibrary/DynamicLibrary.hpp"
+#include "DynamicLibrary/PluginArchive.hpp"
+#include <algorithm>
+#include <atomic>
+#include <cerrno>
 #include <chrono>
+#include <condition_variable>
+#include <cstdint>
+#include <cstdio>
+#include <cstring>
+#include <deque>
+#include <exception>
 #include <fstream>
+#include <future>
 #include <iostream>
 #include <mutex>
+#include <shared_mutex>
 #include <stdexcept>
 #include <thread>
 #include <unordered_map>
+#include <unordered_set>
+#include <utility>
 
 #ifdef _WIN32
 #    include <fileapi.h>
+#    include <process.h>
 #    include <windows.h>
 #    define NOMINMAX
 using LibHandle = HMODULE;
 #    define LIB_EXTENSION ".dll"
 #else
 #    include <dlfcn.h>
+#    include <fcntl.h>
+#    ifdef __linux__
+#        include <link.h>
+#        include <poll.h>
+#        include <sys/auxv.h>
+#        include <sys/eventfd.h>
+#        include <sys/inotify.h>
+#        include <sys/mman.h>
+#        include <sys/sysmacros.h>
+#    endif
+#    include <dirent.h>
 #    include <sys/stat.h>
 #    include <unistd.h>
 using LibHandle = void*;
@@ -28,547 +54,6040 @@ using LibHandle = void*;
 namespace dl
 {
 
+constexpr std::size_t LatencyHistogram::BUCKETS;
+
+namespace
+{
+
 //! ***************************************************************************
-//! \brief Implementation of DynamicLibrary
+//! \brief Book-keeping of the isolated link-map namespaces of the process.
+//! glibc has a fixed number of namespaces (DL_NNS = 16, the base one
+//! included) and dlmopen() fails with a cryptic error once they are used up,
+//! so we count the ones we create and refuse to go beyond the limit.
 //! ***************************************************************************
-class DynamicLibrary::Implementation
+class NamespaceRegistry
 {
 public:
 
+    static NamespaceRegistry& instance()
+    {
+        static NamespaceRegistry registry;
+        return registry;
+    }
+
     //!------------------------------------------------------------------------
-    //! \brief Library information
+    //! \brief Reserve a namespace slot.
+    //! \return false if the limit of isolated namespaces is reached.
     //!------------------------------------------------------------------------
-    struct LibraryInfo
+    bool acquire()
     {
-        LibHandle handle = nullptr;
-        std::string path;
-        std::chrono::system_clock::time_point last_modified;
-        std::unordered_map<std::string, void*> symbol_cache;
-        mutable bool reload_capability_tested = false;
-        mutable bool can_reload = true;
-
-        LibraryInfo() = default;
-        LibraryInfo(const LibraryInfo&) = delete;
-        LibraryInfo& operator=(const LibraryInfo&) = delete;
-
-        //!--------------------------------------------------------------------
-        //! \brief Move constructor
-        //!--------------------------------------------------------------------
-        LibraryInfo(LibraryInfo&& p_other) noexcept
-            : handle(p_other.handle),
-              path(std::move(p_other.path)),
-              last_modified(p_other.last_modified),
-              symbol_cache(std::move(p_other.symbol_cache)),
-              reload_capability_tested(p_other.reload_capability_tested),
-              can_reload(p_other.can_reload)
+        std::lock_guard<std::mutex> lock(m_mutex);
+        if (m_used >= m_limit)
         {
-            p_other.handle = nullptr;
+            return false;
         }
+        ++m_used;
+        return true;
+    }
 
-        //!--------------------------------------------------------------------
-        //! \brief Move assignment operator
-        //!--------------------------------------------------------------------
-        LibraryInfo& operator=(LibraryInfo&& p_other) noexcept
+    //!------------------------------------------------------------------------
+    //! \brief Give back a namespace slot reserved with acquire().
+    //!------------------------------------------------------------------------
+    void release()
+    {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        if (m_used > 0)
         {
-            if (this != &p_other)
-            {
-                handle = p_other.handle;
-                path = std::move(p_other.path);
-                last_modified = p_other.last_modified;
-                symbol_cache = std::move(p_other.symbol_cache);
-                reload_capability_tested = p_other.reload_capability_tested;
-                can_reload = p_other.can_reload;
-                p_other.handle = nullptr;
-            }
-            return *this;
+            --m_used;
         }
-    };
+    }
+
+    void setLimit(std::size_t p_limit)
+    {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        m_limit = std::min(p_limit, MAX_NAMESPACES);
+    }
+
+    std::size_t limit() const
+    {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        return m_limit;
+    }
+
+private:
+
+    //! \brief glibc DL_NNS minus the base namespace.
+    static constexpr std::size_t MAX_NAMESPACES = 15u;
+
+    mutable std::mutex m_mutex;
+    std::size_t m_used = 0;
+    std::size_t m_limit = MAX_NAMESPACES;
+};
+
+constexpr std::size_t NamespaceRegistry::MAX_NAMESPACES;
+
+//!----------------------------------------------------------------------------
+//! \brief Counter incremented each time a library is loaded or unloaded,
+//! giving each load generation a value unique in the process.
+//!----------------------------------------------------------------------------
+std::atomic<std::uint64_t>& loadEpoch()
+{
+    static std::atomic<std::uint64_t> epoch{ 0u };
+    return epoch;
+}
+
+//!----------------------------------------------------------------------------
+//! \brief Temporary file written before being renamed to p_path. Suffixed
+//! by the process id and a counter so that neither two processes nor two
+//! threads (e.g. two managers saving the same cache) write the same one.
+//!----------------------------------------------------------------------------
+std::string temporaryPath(const std::string& p_path)
+{
+    static std::atomic<std::uint64_t> counter{ 0u };
+#ifdef _WIN32
+    auto pid = _getpid();
+#else
+    auto pid = getpid();
+#endif
+    return p_path + "." + std::to_string(pid) + "." +
+           std::to_string(counter.fetch_add(1u, std::memory_order_relaxed));
+}
+
+//! ***************************************************************************
+//! \brief Directory of the persistent symbol caches (empty: disabled)
+//! ***************************************************************************
+struct SymbolCacheSettings
+{
+    static SymbolCacheSettings& instance()
+    {
+        static SymbolCacheSettings settings;
+        return settings;
+    }
+
+    std::string directory() const
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        return path;
+    }
 
-    LibraryInfo lib;
     mutable std::mutex mutex;
-    AutoReload auto_reload = AutoReload::Enabled;
-    std::string error_message;
+    std::string path;
+};
+
+//!----------------------------------------------------------------------------
+//! \brief Arbitrary but stable number of the calling thread, used to spread
+//! the threads over the stripes of the sharded structures
+//!----------------------------------------------------------------------------
+std::size_t threadStripe()
+{
+    static thread_local const std::size_t stripe =
+        std::hash<std::thread::id>()(std::this_thread::get_id());
+    return stripe;
+}
+
+//! ***************************************************************************
+//! \brief Immutable value read without lock and replaced by copy-on-write.
+//! Readers never block nor write a shared cache line: they announce
+//! themselves on one of a few padded counters and read the published
+//! pointer. A writer publishes a new value then waits for the readers that
+//! may still see the old one before deleting it (left-right algorithm: the
+//! two counter sets are drained around the toggle of the version).
+//! Writers must be serialized by the caller.
+//! \tparam STRIPES Number of reader counters of each set: fewer stripes cost
+//!   less memory but share their cache lines between more readers.
+//! ***************************************************************************
+template <typename T, std::size_t STRIPES = 16u>
+class ReadMostly
+{
+public:
+
+    ReadMostly() : m_value(new T()) {}
+
+    ReadMostly(const ReadMostly&) = delete;
+    ReadMostly& operator=(const ReadMostly&) = delete;
 
     //!------------------------------------------------------------------------
-    //! \brief Validate the path of the library
-    //! \param p_path Path of the library
+    //! \brief Call p_reader on the current value, without locking.
+    //! The reference must not escape the call.
     //!------------------------------------------------------------------------
-    bool validatePath(const std::string& p_path)
+    template <typename Reader>
+    auto read(Reader&& p_reader) const
+        -> decltype(p_reader(std::declval<const T&>()))
     {
-        if (p_path.empty())
+        ReaderGuard guard(*this);
+        return p_reader(*m_published.load(std::memory_order_seq_cst));
+    }
+
+    //!------------------------------------------------------------------------
+    //! \brief Current value, for the (serialized) writers only.
+    //!------------------------------------------------------------------------
+    const T& get() const
+    {
+        return *m_value;
+    }
+
+    //!------------------------------------------------------------------------
+    //! \brief Replace the value by a modified copy of it.
+    //!------------------------------------------------------------------------
+    template <typename Writer>
+    void update(Writer&& p_writer)
+    {
+        std::unique_ptr<T> value(new T(*m_value));
+        p_writer(*value);
+        m_published.store(value.get(), std::memory_order_seq_cst);
+
+        // Readers of the previous version may still use the old value
+        unsigned version = m_version.load(std::memory_order_relaxed);
+        waitForReaders((version + 1u) & 1u);
+        m_version.store(version + 1u, std::memory_order_seq_cst);
+        waitForReaders(version & 1u);
+
+        m_value = std::move(value);
+    }
+
+private:
+
+    struct alignas(64) Counter
+    {
+        std::atomic<std::size_t> readers{ 0u };
+    };
+
+    struct ReaderGuard
+    {
+        explicit ReaderGuard(const ReadMostly& p_owner)
+            : counter(p_owner.m_readers[p_owner.m_version.load(
+                                            std::memory_order_seq_cst) &
+                                        1u][threadStripe() % STRIPES])
         {
-            error_message = "Library path cannot be empty";
-            return false;
+            counter.readers.fetch_add(1u, std::memory_order_seq_cst);
         }
 
-        std::ifstream file(p_path);
-        if (!file.good())
+        ~ReaderGuard()
         {
-            error_message =
-                "Library file does not exist or is not accessible: " + p_path;
-            return false;
+            counter.readers.fetch_sub(1u, std::memory_order_release);
         }
-        return true;
-    }
 
-    //!------------------------------------------------------------------------
-    //! \brief Get the file modification time
-    //! \param p_path Path of the file
-    //! \return The file modification time
-    //!------------------------------------------------------------------------
-    std::chrono::system_clock::time_point
-    getFileModificationTime(const std::string& p_path) const
+        Counter& counter;
+    };
+
+    void waitForReaders(unsigned p_set) const
     {
-#ifdef _WIN32
-        WIN32_FILE_ATTRIBUTE_DATA file_info;
-        if (GetFileAttributesExA(
-                p_path.c_str(), GetFileExInfoStandard, &file_info))
+        for (const auto& counter : m_readers[p_set])
         {
-            FILETIME ft = file_info.ftLastWriteTime;
-            ULARGE_INTEGER ull;
-            ull.LowPart = ft.dwLowDateTime;
-            ull.HighPart = ft.dwHighDateTime;
+            while (counter.readers.load(std::memory_order_acquire) != 0u)
+            {
+                std::this_thread::yield();
+            }
+        }
+    }
 
-            auto duration = std::chrono::nanoseconds(
-                (ull.QuadPart - 116444736000000000ULL) * 100);
-            return std::chrono::system_clock::time_point(duration);
+    std::unique_ptr<T> m_value;
+    std::atomic<const T*> m_published{ m_value.get() };
+    std::atomic<unsigned> m_version{ 0u };
+    mutable Counter m_readers[2][STRIPES];
+};
+
+//! ***************************************************************************
+//! \brief Pool of threads running parallel loops split in chunks. Each worker
+//! owns a queue: it runs its own chunks from the back and, once out of work,
+//! steals the oldest chunks of the other workers. The thread waiting for a
+//! loop runs chunks too, so that nested loops make progress.
+//! ***************************************************************************
+class WorkStealingPool
+{
+public:
+
+    explicit WorkStealingPool(std::size_t p_workers)
+    {
+        for (std::size_t i = 0u; i < p_workers; ++i)
+        {
+            m_queues.emplace_back(new Queue());
         }
-#else
-        struct stat file_stat;
-        if (stat(p_path.c_str(), &file_stat) == 0)
+        for (std::size_t i = 0u; i < p_workers; ++i)
         {
-            return std::chrono::system_clock::from_time_t(file_stat.st_mtime);
+            m_workers.emplace_back([this, i]() { work(i); });
         }
-#endif
-        return std::chrono::system_clock::now();
     }
 
-    //!------------------------------------------------------------------------
-    //! \brief Load the library
-    //!------------------------------------------------------------------------
-    bool loadInternal()
+    WorkStealingPool(const WorkStealingPool&) = delete;
+    WorkStealingPool& operator=(const WorkStealingPool&) = delete;
+
+    ~WorkStealingPool()
     {
-#ifdef _WIN32
-        lib.handle = LoadLibraryA(lib.path.c_str());
-        if (!lib.handle)
         {
-            DWORD error = GetLastError();
-            error_message = "Failed to load library '" + lib.path +
-                            "' (Error: " + std::to_string(error) + ")";
-            return false;
+            std::lock_guard<std::mutex> lock(m_mutex);
+            m_stop = true;
         }
-#else
-        lib.handle = dlopen(lib.path.c_str(), RTLD_NOW | RTLD_LOCAL);
-        if (!lib.handle)
+        m_condition.notify_all();
+        for (auto& worker : m_workers)
         {
-            std::string error = dlerror() ? dlerror() : "Unknown error";
-            error_message =
-                "Failed to load library '" + lib.path + "': " + error;
-            return false;
+            worker.join();
         }
-#endif
-        return true;
     }
 
     //!------------------------------------------------------------------------
-    //! \brief Unload the library
-    //! \return True if successful, false otherwise
+    //! \brief Call p_task(i) for i in [0, p_count) and wait for the calls.
+    //! The first exception thrown by a call is rethrown.
     //!------------------------------------------------------------------------
-    bool unloadInternal()
+    void run(std::size_t p_count,
+             const std::function<void(std::size_t)>& p_task)
     {
-        if (!lib.handle)
-            return true;
+        // Several chunks per thread, for the thieves to balance the load
+        const std::size_t queues = m_queues.size();
+        const std::size_t chunk_size =
+            std::max<std::size_t>(1u, p_count / (4u * (queues + 1u)));
 
-        lib.symbol_cache.clear();
+        const std::size_t chunks = (p_count + chunk_size - 1u) / chunk_size;
 
-#ifdef _WIN32
-        bool success = FreeLibrary(lib.handle);
-        if (!success)
+        Loop loop;
+        loop.task = &p_task;
+        loop.pending.store(p_count, std::memory_order_relaxed);
+
+        // Counted first, so that the count never goes below the queued ones
         {
-            DWORD error = GetLastError();
-            error_message = "Failed to unload library '" + lib.path +
-                            "' (Error: " + std::to_string(error) + ")";
+            std::lock_guard<std::mutex> lock(m_mutex);
+            m_queued += chunks;
         }
-        lib.handle = nullptr;
-        return success;
-#else
-        bool success = (dlclose(lib.handle) == 0);
-        if (!success)
+        for (std::size_t i = 0u; i < chunks; ++i)
         {
-            std::string error = dlerror() ? dlerror() : "Unknown error";
-            error_message =
-                "Failed to unload library '" + lib.path + "': " + error;
+            Queue& queue = *m_queues[i % queues];
+            std::lock_guard<std::mutex> lock(queue.mutex);
+            queue.chunks.push_back(
+                Chunk{ &loop,
+                       i * chunk_size,
+                       std::min(p_count, (i + 1u) * chunk_size) });
+        }
+        m_condition.notify_all();
+
+        Chunk chunk;
+        for (;;)
+        {
+            if (take(queues, chunk))
+            {
+                execute(chunk);
+                continue;
+            }
+            std::unique_lock<std::mutex> lock(m_mutex);
+            m_condition.wait(
+                lock,
+                [&loop, this]()
+                {
+                    return (m_queued != 0u) ||
+                           (loop.pending.load(std::memory_order_acquire) ==
+                            0u);
+                });
+            if (loop.pending.load(std::memory_order_acquire) == 0u)
+            {
+                break;
+            }
+        }
+
+        if (loop.error)
+        {
+            std::rethrow_exception(loop.error);
         }
-        lib.handle = nullptr;
-        return success;
-#endif
     }
 
+private:
+
+    struct Loop
+    {
+        const std::function<void(std::size_t)>* task;
+        std::atomic<std::size_t> pending;
+        std::mutex mutex;
+        std::exception_ptr error;
+    };
+
+    struct Chunk
+    {
+        Loop* loop;
+        std::size_t begin;
+        std::size_t end;
+    };
+
+    struct Queue
+    {
+        std::mutex mutex;
+        std::deque<Chunk> chunks;
+    };
+
     //!------------------------------------------------------------------------
-    //! \brief Get a symbol from the library
-    //! \param p_symbol_name Name of the symbol to get
-    //! \return The symbol
+    //! \brief Take a chunk: the newest of the own queue, else the oldest of
+    //! another queue
+    //! \param p_self Index of the worker (the number of workers for a thread
+    //!   outside the pool)
     //!------------------------------------------------------------------------
-    void* getSymbolInternal(const std::string& p_symbol_name)
+    bool take(std::size_t p_self, Chunk& p_chunk)
     {
-#ifdef _WIN32
-        void* symbol = reinterpret_cast<void*>(
-            GetProcAddress(lib.handle, p_symbol_name.c_str()));
-        if (!symbol)
+        const std::size_t queues = m_queues.size();
+        if (p_self < queues)
         {
-            error_message = "Symbol '" + p_symbol_name +
-                            "' not found in library '" + lib.path + "'";
+            Queue& queue = *m_queues[p_self];
+            std::lock_guard<std::mutex> lock(queue.mutex);
+            if (!queue.chunks.empty())
+            {
+                p_chunk = queue.chunks.back();
+                queue.chunks.pop_back();
+                taken();
+                return true;
+            }
         }
-        return symbol;
-#else
-        dlerror(); // Clear any previous error
-        void* symbol = dlsym(lib.handle, p_symbol_name.c_str());
-        char* error = dlerror();
-        if (error)
+        for (std::size_t i = 1u; i <= queues; ++i)
         {
-            error_message = "Symbol '" + p_symbol_name +
-                            "' not found in library '" + lib.path +
-                            "': " + error;
-            return nullptr;
+            Queue& queue = *m_queues[(p_self + i) % queues];
+            std::lock_guard<std::mutex> lock(queue.mutex);
+            if (!queue.chunks.empty())
+            {
+                p_chunk = queue.chunks.front();
+                queue.chunks.pop_front();
+                taken();
+                return true;
+            }
         }
-        return symbol;
-#endif
+        return false;
     }
 
-    //!------------------------------------------------------------------------
-    //! \brief Check if the library needs to be reloaded
-    //! \return True if the library needs to be reloaded, false otherwise
-    //!------------------------------------------------------------------------
-    bool needsReload() const
+    void taken()
     {
-        auto current_mod_time = getFileModificationTime(lib.path);
-        return current_mod_time > lib.last_modified;
+        std::lock_guard<std::mutex> lock(m_mutex);
+        --m_queued;
     }
 
-    //!------------------------------------------------------------------------
-    //! \brief Test if the library can be reloaded (lazy evaluation)
-    //! \return True if the library can be reloaded, false otherwise
-    //!------------------------------------------------------------------------
-    bool canReload() const
+    void execute(const Chunk& p_chunk)
     {
-        if (!lib.handle || lib.reload_capability_tested)
+        Loop& loop = *p_chunk.loop;
+        for (std::size_t i = p_chunk.begin; i < p_chunk.end; ++i)
         {
-            return lib.can_reload;
-        }
-
-        // Test once in a non-destructive way
-        lib.reload_capability_tested = true;
+            try
+            {
+                (*loop.task)(i);
+            }
+            catch (...)
+            {
+                std::lock_guard<std::mutex> lock(loop.mutex);
+                if (!loop.error)
+                {
+                    loop.error = std::current_exception();
+                }
+            }
+        }
 
-#ifdef _WIN32
-        // On can test by incrementing/decrementing the reference counter
-        HMODULE test_handle = LoadLibraryA(lib.path.c_str());
-        if (test_handle)
+        const std::size_t count = p_chunk.end - p_chunk.begin;
+        if (loop.pending.fetch_sub(count, std::memory_order_acq_rel) == count)
         {
-            bool can_free = FreeLibrary(test_handle);
-            lib.can_reload = can_free;
+            // Last chunk: wake the thread waiting for the loop up
+            {
+                std::lock_guard<std::mutex> lock(m_mutex);
+            }
+            m_condition.notify_all();
         }
-        else
+    }
+
+    void work(std::size_t p_index)
+    {
+        Chunk chunk;
+        for (;;)
         {
-            lib.can_reload = false;
+            if (take(p_index, chunk))
+            {
+                execute(chunk);
+                continue;
+            }
+            std::unique_lock<std::mutex> lock(m_mutex);
+            m_condition.wait(lock,
+                             [this]() { return m_stop || (m_queued != 0u); });
+            if (m_stop)
+            {
+                return;
+            }
         }
-#else
-        // On test with RTLD_NOLOAD to see if the lib is already loaded
-        // then we try a quick dlopen/dlclose
-        void* test_handle = dlopen(lib.path.c_str(), RTLD_NOW | RTLD_NOLOAD);
-        if (test_handle)
+    }
+
+    std::vector<std::unique_ptr<Queue>> m_queues;
+    std::vector<std::thread> m_workers;
+    //! \brief Guards m_queued and m_stop, for the sleeping threads
+    std::mutex m_mutex;
+    std::condition_variable m_condition;
+    //! \brief Number of chunks waiting in the queues
+    std::size_t m_queued = 0u;
+    bool m_stop = false;
+};
+
+//! ***************************************************************************
+//! \brief Bounded multi-producer single-consumer queue: a ring of cells
+//! stamped with a sequence number (Vyukov's algorithm). Producers claim a
+//! cell with a CAS on the tail and never wait: push() fails when the ring is
+//! full. The consumer must be serialized by the caller.
+//! ***************************************************************************
+template <typename T>
+class BoundedQueue
+{
+public:
+
+    //! \param p_capacity Number of cells, a power of two
+    explicit BoundedQueue(std::size_t p_capacity)
+        : m_cells(new Cell[p_capacity]), m_mask(p_capacity - 1u)
+    {
+        for (std::size_t i = 0u; i < p_capacity; ++i)
         {
-            // La lib est déjà en mémoire, on peut tester dlclose
-            lib.can_reload = (dlclose(test_handle) == 0);
+            m_cells[i].sequence.store(i, std::memory_order_relaxed);
         }
-        else
+    }
+
+    bool push(T&& p_value)
+    {
+        std::size_t position = m_tail.load(std::memory_order_relaxed);
+        Cell* cell;
+        for (;;)
         {
-            // Not in memory yet, we do a quick test
-            test_handle = dlopen(lib.path.c_str(), RTLD_NOW | RTLD_LOCAL);
-            if (test_handle)
+            cell = &m_cells[position & m_mask];
+            std::size_t sequence =
+                cell->sequence.load(std::memory_order_acquire);
+            auto difference = static_cast<std::intptr_t>(sequence) -
+                              static_cast<std::intptr_t>(position);
+            if (difference == 0)
+            {
+                if (m_tail.compare_exchange_weak(
+                        position, position + 1u, std::memory_order_relaxed))
+                {
+                    break;
+                }
+            }
+            else if (difference < 0)
+            {
+                return false; // Not consumed yet: the ring is full
+            }
+            else
+            {
+                position = m_tail.load(std::memory_order_relaxed);
+            }
+        }
+        cell->value = std::move(p_value);
+        cell->sequence.store(position + 1u, std::memory_order_release);
+        return true;
+    }
+
+    bool pop(T& p_value)
+    {
+        Cell& cell = m_cells[m_head & m_mask];
+        if (cell.sequence.load(std::memory_order_acquire) != m_head + 1u)
+        {
+            return false;
+        }
+        p_value = std::move(cell.value);
+        cell.value = T();
+        cell.sequence.store(m_head + m_mask + 1u, std::memory_order_release);
+        ++m_head;
+        return true;
+    }
+
+private:
+
+    struct Cell
+    {
+        std::atomic<std::size_t> sequence;
+        T value;
+    };
+
+    std::unique_ptr<Cell[]> m_cells;
+    const std::size_t m_mask;
+    std::atomic<std::size_t> m_tail{ 0u };
+    std::size_t m_head = 0u;
+};
+
+//! ***************************************************************************
+//! \brief Subscribers of the events of a library (or of the libraries of a
+//! manager) and queue of the events waiting for delivery. Publishing never
+//! takes a lock nor calls a subscriber.
+//! ***************************************************************************
+class EventHub: public std::enable_shared_from_this<EventHub>
+{
+public:
+
+    explicit EventHub(std::size_t p_capacity)
+        : m_queue(p_capacity)
+    {
+    }
+
+    //! \brief Whether anybody listens: events are dropped otherwise
+    bool active() const
+    {
+        return m_active.load(std::memory_order_relaxed);
+    }
+
+    //!------------------------------------------------------------------------
+    //! \brief Queue an event. The caller calls schedule() once it holds no
+    //! lock: an inline executor delivers the events on the calling thread.
+    //!------------------------------------------------------------------------
+    void publish(LibraryNotification&& p_notification)
+    {
+        if (!m_queue.push(std::move(p_notification)))
+        {
+            m_dropped.fetch_add(1u, std::memory_order_relaxed);
+        }
+    }
+
+    SubscriptionId subscribe(EventCallback&& p_callback)
+    {
+        static std::atomic<SubscriptionId> last_id{ 0u };
+        SubscriptionId id = ++last_id;
+
+        std::lock_guard<std::mutex> lock(m_mutex);
+        auto subscribers = std::make_shared<Subscribers>(*m_subscribers);
+        subscribers->emplace_back(id, std::move(p_callback));
+        m_subscribers = std::move(subscribers);
+        m_active.store(true, std::memory_order_relaxed);
+        return id;
+    }
+
+    void unsubscribe(SubscriptionId p_id)
+    {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        auto subscribers = std::make_shared<Subscribers>(*m_subscribers);
+        subscribers->erase(
+            std::remove_if(subscribers->begin(),
+                           subscribers->end(),
+                           [p_id](const Subscribers::value_type& p_subscriber)
+                           { return p_subscriber.first == p_id; }),
+            subscribers->end());
+        m_active.store(!subscribers->empty(), std::memory_order_relaxed);
+        m_subscribers = std::move(subscribers);
+    }
+
+    void setExecutor(EventExecutor&& p_executor)
+    {
+        {
+            std::lock_guard<std::mutex> lock(m_mutex);
+            m_executor.update([&p_executor](EventExecutor& p_current)
+                              { p_current = std::move(p_executor); });
+        }
+        schedule(); // Events queued before may wait for a dispatch
+    }
+
+    //! \brief Stop the deliveries: the owner is going away
+    void close()
+    {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        m_active.store(false, std::memory_order_relaxed);
+        m_subscribers = std::make_shared<Subscribers>();
+        m_executor.update([](EventExecutor& p_current)
+                          { p_current = nullptr; });
+    }
+
+    std::size_t dispatch()
+    {
+        // A subscriber scheduling a delivery with an inline executor: the
+        // loop below already delivers the events it queued.
+        if (m_dispatcher.load(std::memory_order_relaxed) ==
+            std::this_thread::get_id())
+        {
+            return 0u;
+        }
+        std::lock_guard<std::mutex> dispatch_lock(m_dispatch_mutex);
+        m_dispatcher.store(std::this_thread::get_id(),
+                           std::memory_order_relaxed);
+        std::shared_ptr<const Subscribers> subscribers;
+        {
+            std::lock_guard<std::mutex> lock(m_mutex);
+            subscribers = m_subscribers;
+        }
+
+        std::size_t count = 0u;
+        LibraryNotification notification;
+        while (m_queue.pop(notification))
+        {
+            notification.dropped =
+                m_dropped.exchange(0u, std::memory_order_relaxed);
+            for (const auto& subscriber : *subscribers)
+            {
+                subscriber.second(notification);
+            }
+            ++count;
+        }
+        m_dispatcher.store(std::thread::id(), std::memory_order_relaxed);
+        return count;
+    }
+
+    //!------------------------------------------------------------------------
+    //! \brief Give a delivery task to the executor, unless one is pending.
+    //! The executor is called outside of the reader section: it may set the
+    //! executor again.
+    //!------------------------------------------------------------------------
+    void schedule()
+    {
+        EventExecutor executor =
+            m_executor.read([](const EventExecutor& p_executor)
+                            { return p_executor; });
+        if (!executor || m_scheduled.exchange(true, std::memory_order_acq_rel))
+        {
+            return;
+        }
+        // Clearing the flag before the delivery lets the events pushed
+        // meanwhile schedule the next task.
+        std::shared_ptr<EventHub> self = shared_from_this();
+        executor(
+            [self]()
+            {
+                self->m_scheduled.exchange(false, std::memory_order_acq_rel);
+                self->dispatch();
+            });
+    }
+
+private:
+
+    using Subscribers = std::vector<std::pair<SubscriptionId, EventCallback>>;
+
+    BoundedQueue<LibraryNotification> m_queue;
+    std::atomic<std::size_t> m_dropped{ 0u };
+    std::atomic<bool> m_active{ false };
+    std::atomic<bool> m_scheduled{ false };
+    //! \brief Guards the writers of the subscribers and of the executor
+    std::mutex m_mutex;
+    //! \brief Serializes the consumers of the queue
+    std::mutex m_dispatch_mutex;
+    //! \brief Thread delivering the events, under m_dispatch_mutex
+    std::atomic<std::thread::id> m_dispatcher{};
+    std::shared_ptr<const Subscribers> m_subscribers =
+        std::make_shared<Subscribers>();
+    ReadMostly<EventExecutor> m_executor;
+};
+
+//! \brief Capacity of the event queue of a library, and of a manager
+constexpr std::size_t LIBRARY_EVENTS = 64u;
+constexpr std::size_t MANAGER_EVENTS = 1024u;
+
+//! ***************************************************************************
+//! \brief Thread running the dlopen() and dlclose() calls of the libraries of
+//! a manager, so that the callers wait on a future rather than convoy on the
+//! lock of the dynamic loader. The requests queued while a batch runs form
+//! the next batch, taken at once. Calls run on the calling thread while the
+//! thread is stopped, and when made by the loader thread itself.
+//! ***************************************************************************
+class LoaderQueue
+{
+public:
+
+    LoaderQueue() = default;
+    LoaderQueue(const LoaderQueue&) = delete;
+    LoaderQueue& operator=(const LoaderQueue&) = delete;
+
+    ~LoaderQueue()
+    {
+        stop();
+    }
+
+    //! \brief Start the thread. Not concurrent with stop().
+    void start()
+    {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        if (m_thread.joinable())
+        {
+            return;
+        }
+        m_stop = false;
+        m_thread = std::thread([this]() { loop(); });
+        m_thread_id = m_thread.get_id();
+    }
+
+    //! \brief Run the queued calls then stop the thread. Not concurrent with
+    //! start().
+    void stop()
+    {
+        {
+            std::lock_guard<std::mutex> lock(m_mutex);
+            if (!m_thread.joinable())
+            {
+                return;
+            }
+            m_stop = true;
+        }
+        m_condition.notify_one();
+        m_thread.join();
+
+        std::lock_guard<std::mutex> lock(m_mutex);
+        m_thread = std::thread();
+        m_thread_id = std::thread::id();
+    }
+
+    //!------------------------------------------------------------------------
+    //! \brief Run a call on the loader thread and wait for its result.
+    //!------------------------------------------------------------------------
+    template <typename Call>
+    auto run(Call&& p_call) -> decltype(p_call())
+    {
+        using Result = decltype(p_call());
+        std::future<Result> result;
+        {
+            std::unique_lock<std::mutex> lock(m_mutex);
+            if (m_stop || (std::this_thread::get_id() == m_thread_id))
+            {
+                lock.unlock();
+                return p_call();
+            }
+
+            auto task = std::make_shared<std::packaged_task<Result()>>(
+                std::forward<Call>(p_call));
+            result = task->get_future();
+            m_tasks.emplace_back([task]() { (*task)(); });
+        }
+        m_condition.notify_one();
+        return result.get();
+    }
+
+private:
+
+    void loop()
+    {
+        std::unique_lock<std::mutex> lock(m_mutex);
+        for (;;)
+        {
+            m_condition.wait(lock,
+                             [this]() { return m_stop || !m_tasks.empty(); });
+            if (m_tasks.empty())
+            {
+                return;
+            }
+            std::deque<std::function<void()>> batch;
+            batch.swap(m_tasks);
+            lock.unlock();
+            for (auto& task : batch)
+            {
+                task();
+            }
+            lock.lock();
+        }
+    }
+
+    std::mutex m_mutex;
+    std::condition_variable m_condition;
+    std::deque<std::function<void()>> m_tasks;
+    //! \brief Set while the thread is not running, or stopping
+    bool m_stop = true;
+    std::thread m_thread;
+    std::thread::id m_thread_id;
+};
+
+//! ***************************************************************************
+//! \brief Operations measured by OperationMetrics
+//! ***************************************************************************
+enum class Operation
+{
+    Load,
+    LookupHit,
+    LookupMiss,
+    Reload,
+    Unload,
+    ReloadProbe,
+    Count
+};
+
+//! ***************************************************************************
+//! \brief Latency histograms of the operations of a library, sharded by
+//! thread: recording is a few relaxed increments on cache lines that other
+//! threads rarely touch. Shards are allocated on first use, so idle libraries
+//! cost a few pointers.
+//! ***************************************************************************
+class OperationMetrics
+{
+public:
+
+    OperationMetrics() = default;
+    OperationMetrics(const OperationMetrics&) = delete;
+    OperationMetrics& operator=(const OperationMetrics&) = delete;
+
+    ~OperationMetrics()
+    {
+        for (auto& shard : m_shards)
+        {
+            delete shard.load();
+        }
+    }
+
+    //! \brief Whether the callers should record their operations
+    bool isEnabled() const
+    {
+        return m_enabled.load(std::memory_order_relaxed);
+    }
+
+    void enable(bool p_enabled)
+    {
+        m_enabled.store(p_enabled, std::memory_order_relaxed);
+    }
+
+    void record(Operation p_operation, std::chrono::nanoseconds p_duration)
+    {
+        auto& shard = m_shards[threadStripe() % SHARDS];
+        Shard* counters = shard.load(std::memory_order_acquire);
+        if (!counters)
+        {
+            std::unique_ptr<Shard> created(new Shard());
+            if (shard.compare_exchange_strong(counters,
+                                              created.get(),
+                                              std::memory_order_acq_rel))
+            {
+                counters = created.release();
+            }
+        }
+
+        auto ns = static_cast<std::uint64_t>(std::max<std::int64_t>(
+            p_duration.count(), 0));
+        std::size_t bucket = 0u;
+        while ((bucket + 1u < LatencyHistogram::BUCKETS) &&
+               ((ns >> (bucket + 1u)) != 0u))
+        {
+            ++bucket;
+        }
+
+        auto& histogram = counters->histograms[std::size_t(p_operation)];
+        histogram.count.fetch_add(1u, std::memory_order_relaxed);
+        histogram.total_ns.fetch_add(ns, std::memory_order_relaxed);
+        histogram.buckets[bucket].fetch_add(1u, std::memory_order_relaxed);
+    }
+
+    LibraryMetrics snapshot() const
+    {
+        LibraryMetrics metrics;
+        LatencyHistogram* histograms[] = {
+            &metrics.load,   &metrics.lookup_hit, &metrics.lookup_miss,
+            &metrics.reload, &metrics.unload,     &metrics.reload_probe
+        };
+        static_assert(sizeof(histograms) / sizeof(histograms[0]) ==
+                          std::size_t(Operation::Count),
+                      "One histogram per operation");
+
+        for (const auto& shard : m_shards)
+        {
+            const Shard* counters = shard.load(std::memory_order_acquire);
+            if (!counters)
+            {
+                continue;
+            }
+            for (std::size_t i = 0u; i < std::size_t(Operation::Count); ++i)
+            {
+                const auto& from = counters->histograms[i];
+                LatencyHistogram& to = *histograms[i];
+                to.count += from.count.load(std::memory_order_relaxed);
+                to.total_ns += from.total_ns.load(std::memory_order_relaxed);
+                for (std::size_t b = 0u; b < LatencyHistogram::BUCKETS; ++b)
+                {
+                    to.buckets[b] +=
+                        from.buckets[b].load(std::memory_order_relaxed);
+                }
+            }
+        }
+        return metrics;
+    }
+
+private:
+
+    static constexpr std::size_t SHARDS = 16u;
+
+    //! \brief Each shard is a separate allocation of a few cache lines
+    struct Shard
+    {
+        struct Histogram
+        {
+            std::atomic<std::uint64_t> count{ 0u };
+            std::atomic<std::uint64_t> total_ns{ 0u };
+            std::atomic<std::uint64_t> buckets[LatencyHistogram::BUCKETS] = {};
+        };
+        Histogram histograms[std::size_t(Operation::Count)];
+    };
+
+    std::atomic<Shard*> m_shards[SHARDS] = {};
+    std::atomic<bool> m_enabled{ true };
+};
+
+constexpr std::size_t OperationMetrics::SHARDS;
+
+//! ***************************************************************************
+//! \brief Record the duration of an operation when leaving the scope
+//! ***************************************************************************
+class ScopedTimer
+{
+public:
+
+    ScopedTimer(OperationMetrics& p_metrics, Operation p_operation)
+        : m_metrics(p_metrics),
+          m_operation(p_operation),
+          m_enabled(p_metrics.isEnabled())
+    {
+        if (m_enabled)
+        {
+            m_start = std::chrono::steady_clock::now();
+        }
+    }
+
+    ~ScopedTimer()
+    {
+        if (m_enabled)
+        {
+            m_metrics.record(m_operation,
+                             std::chrono::steady_clock::now() - m_start);
+        }
+    }
+
+private:
+
+    OperationMetrics& m_metrics;
+    Operation m_operation;
+    bool m_enabled;
+    std::chrono::steady_clock::time_point m_start;
+};
+
+//! ***************************************************************************
+//! \brief Identity of a library file on disk. Any difference with the
+//! signature recorded at load time means that the file has been replaced or
+//! modified.
+//! ***************************************************************************
+struct FileSignature
+{
+    std::int64_t mtime_ns = 0;
+    std::uint64_t size = 0;
+    std::uint64_t inode = 0;
+    std::uint64_t device = 0;
+
+    bool operator==(const FileSignature& p_other) const
+    {
+        return (mtime_ns == p_other.mtime_ns) && (size == p_other.size) &&
+               (inode == p_other.inode) && (device == p_other.device);
+    }
+
+    bool operator!=(const FileSignature& p_other) const
+    {
+        return !(*this == p_other);
+    }
+};
+
+#ifndef _WIN32
+//!----------------------------------------------------------------------------
+//! \brief Build the signature of a file from its stat information
+//!----------------------------------------------------------------------------
+FileSignature toSignature(const struct stat& p_stat)
+{
+    FileSignature signature;
+#    ifdef __linux__
+    signature.mtime_ns = std::int64_t(p_stat.st_mtim.tv_sec) * 1000000000 +
+                         p_stat.st_mtim.tv_nsec;
+#    else
+    signature.mtime_ns = std::int64_t(p_stat.st_mtime) * 1000000000;
+#    endif
+    signature.size = static_cast<std::uint64_t>(p_stat.st_size);
+    signature.inode = static_cast<std::uint64_t>(p_stat.st_ino);
+    signature.device = static_cast<std::uint64_t>(p_stat.st_dev);
+    return signature;
+}
+#endif
+
+#ifdef __linux__
+//!----------------------------------------------------------------------------
+//! \brief Get the program headers of a loaded object. dl_iterate_phdr() only
+//! walks the namespace of its caller, so they are read from the ELF header
+//! mapped at the load base instead.
+//! \return false if the program headers cannot be found
+//!----------------------------------------------------------------------------
+bool programHeaders(const struct link_map* p_map,
+                    const ElfW(Phdr)*& p_phdr,
+                    std::size_t& p_phnum)
+{
+    if (p_map->l_addr == 0)
+    {
+        // Non-PIE main program
+        p_phdr = reinterpret_cast<const ElfW(Phdr)*>(getauxval(AT_PHDR));
+        p_phnum = getauxval(AT_PHNUM);
+        return p_phdr != nullptr;
+    }
+
+    auto ehdr = reinterpret_cast<const ElfW(Ehdr)*>(p_map->l_addr);
+    if (std::memcmp(ehdr->e_ident, ELFMAG, SELFMAG) != 0)
+    {
+        return false;
+    }
+    p_phdr =
+        reinterpret_cast<const ElfW(Phdr)*>(p_map->l_addr + ehdr->e_phoff);
+    p_phnum = ehdr->e_phnum;
+    return true;
+}
+
+//!----------------------------------------------------------------------------
+//! \brief Size of the pages mapped for a segment
+//!----------------------------------------------------------------------------
+std::size_t segmentPages(const ElfW(Phdr)& p_phdr)
+{
+    static const std::size_t page = std::size_t(sysconf(_SC_PAGESIZE));
+    std::size_t start = p_phdr.p_vaddr & ~(page - 1u);
+    std::size_t end = (p_phdr.p_vaddr + p_phdr.p_memsz + page - 1u) &
+                      ~(page - 1u);
+    return end - start;
+}
+
+//!----------------------------------------------------------------------------
+//! \brief Total size of the pages mapped for the loadable segments of a
+//! loaded object
+//!----------------------------------------------------------------------------
+std::size_t loadedSize(const struct link_map* p_map)
+{
+    const ElfW(Phdr)* phdr = nullptr;
+    std::size_t phnum = 0;
+    std::size_t size = 0;
+    if (programHeaders(p_map, phdr, phnum))
+    {
+        for (std::size_t i = 0; i < phnum; ++i)
+        {
+            if (phdr[i].p_type == PT_LOAD)
+            {
+                size += segmentPages(phdr[i]);
+            }
+        }
+    }
+    return size;
+}
+
+//!----------------------------------------------------------------------------
+//! \brief Look for the GNU build-id in the content of a PT_NOTE segment
+//! \return The build-id in hexadecimal, or an empty string if not found
+//!----------------------------------------------------------------------------
+std::string buildIdFromNotes(const char* p_begin, const char* p_end)
+{
+    const char* note = p_begin;
+    while (note + sizeof(ElfW(Nhdr)) <= p_end)
+    {
+        auto header = reinterpret_cast<const ElfW(Nhdr)*>(note);
+        const char* name = note + sizeof(ElfW(Nhdr));
+        const char* desc = name + ((header->n_namesz + 3u) & ~3u);
+        note = desc + ((header->n_descsz + 3u) & ~3u);
+        if ((note > p_end) || (header->n_type != NT_GNU_BUILD_ID) ||
+            (header->n_namesz != 4u) || (std::memcmp(name, "GNU", 4) != 0))
+        {
+            continue;
+        }
+
+        static const char digits[] = "0123456789abcdef";
+        std::string id;
+        for (ElfW(Word) j = 0; j < header->n_descsz; ++j)
+        {
+            unsigned char byte = static_cast<unsigned char>(desc[j]);
+            id += digits[byte >> 4];
+            id += digits[byte & 0xf];
+        }
+        return id;
+    }
+    return {};
+}
+
+//!----------------------------------------------------------------------------
+//! \brief Read the GNU build-id of a loaded object from its PT_NOTE segments
+//! \return The build-id in hexadecimal, or an empty string if not found
+//!----------------------------------------------------------------------------
+std::string buildIdOf(const struct link_map* p_map)
+{
+    const ElfW(Phdr)* phdr = nullptr;
+    std::size_t phnum = 0;
+    if (!programHeaders(p_map, phdr, phnum))
+    {
+        return {};
+    }
+
+    for (std::size_t i = 0; i < phnum; ++i)
+    {
+        if (phdr[i].p_type == PT_NOTE)
+        {
+            const char* notes =
+                reinterpret_cast<const char*>(p_map->l_addr + phdr[i].p_vaddr);
+            std::string id = buildIdFromNotes(notes, notes + phdr[i].p_memsz);
+            if (!id.empty())
+            {
+                return id;
+            }
+        }
+    }
+    return {};
+}
+
+//!----------------------------------------------------------------------------
+//! \brief Read the GNU build-id of an ELF file without loading it
+//! \param p_fd Descriptor of the file
+//! \return The build-id in hexadecimal, or an empty string if not found
+//!----------------------------------------------------------------------------
+std::string buildIdOfFile(int p_fd)
+{
+    ElfW(Ehdr) ehdr;
+    if ((pread(p_fd, &ehdr, sizeof(ehdr), 0) != ssize_t(sizeof(ehdr))) ||
+        (std::memcmp(ehdr.e_ident, ELFMAG, SELFMAG) != 0) ||
+        (ehdr.e_ident[EI_CLASS] !=
+         ((sizeof(void*) == 8u) ? ELFCLASS64 : ELFCLASS32)) ||
+        (ehdr.e_phentsize != sizeof(ElfW(Phdr))))
+    {
+        return {};
+    }
+
+    std::vector<ElfW(Phdr)> phdr(ehdr.e_phnum);
+    ssize_t size = ssize_t(phdr.size() * sizeof(ElfW(Phdr)));
+    if (pread(p_fd, phdr.data(), size_t(size), off_t(ehdr.e_phoff)) != size)
+    {
+        return {};
+    }
+
+    std::vector<char> notes;
+    for (const auto& segment : phdr)
+    {
+        if ((segment.p_type != PT_NOTE) || (segment.p_filesz > 65536u))
+        {
+            continue;
+        }
+        notes.resize(segment.p_filesz);
+        ssize_t length = ssize_t(notes.size());
+        if (pread(p_fd, notes.data(), notes.size(), off_t(segment.p_offset)) ==
+            length)
+        {
+            std::string id =
+                buildIdFromNotes(notes.data(), notes.data() + notes.size());
+            if (!id.empty())
+            {
+                return id;
+            }
+        }
+    }
+    return {};
+}
+
+//!----------------------------------------------------------------------------
+//! \brief Check if an address belongs to a loadable segment of an object
+//!----------------------------------------------------------------------------
+bool isInsideObject(const struct link_map* p_map, std::uintptr_t p_address)
+{
+    const ElfW(Phdr)* phdr = nullptr;
+    std::size_t phnum = 0;
+    if (!programHeaders(p_map, phdr, phnum))
+    {
+        return false;
+    }
+
+    for (std::size_t i = 0; i < phnum; ++i)
+    {
+        std::uintptr_t start = p_map->l_addr + phdr[i].p_vaddr;
+        if ((phdr[i].p_type == PT_LOAD) && (p_address >= start) &&
+            (p_address < start + phdr[i].p_memsz))
+        {
+            return true;
+        }
+    }
+    return false;
+}
+
+//!----------------------------------------------------------------------------
+//! \brief List the symbols defined and exported by a loaded object, from its
+//! dynamic symbol table. The number of symbols is taken from the DT_HASH or
+//! DT_GNU_HASH table since the dynamic section does not record it.
+//!----------------------------------------------------------------------------
+std::vector<std::string> exportedSymbols(const struct link_map* p_map)
+{
+    const ElfW(Sym)* symtab = nullptr;
+    const char* strtab = nullptr;
+    const ElfW(Word)* hash = nullptr;
+    const std::uint32_t* gnu_hash = nullptr;
+
+    // Most ports relocate the dynamic section in place, but not all of them
+    auto address = [p_map](ElfW(Addr) p_pointer)
+    {
+        return (p_pointer < p_map->l_addr) ? p_map->l_addr + p_pointer
+                                           : p_pointer;
+    };
+    for (const ElfW(Dyn)* dyn = p_map->l_ld; dyn && (dyn->d_tag != DT_NULL);
+         ++dyn)
+    {
+        switch (dyn->d_tag)
+        {
+            case DT_SYMTAB:
+                symtab = reinterpret_cast<const ElfW(Sym)*>(
+                    address(dyn->d_un.d_ptr));
+                break;
+            case DT_STRTAB:
+                strtab = reinterpret_cast<const char*>(
+                    address(dyn->d_un.d_ptr));
+                break;
+            case DT_HASH:
+                hash = reinterpret_cast<const ElfW(Word)*>(
+                    address(dyn->d_un.d_ptr));
+                break;
+            case DT_GNU_HASH:
+                gnu_hash = reinterpret_cast<const std::uint32_t*>(
+                    address(dyn->d_un.d_ptr));
+                break;
+            default:
+                break;
+        }
+    }
+    if (!symtab || !strtab || (!hash && !gnu_hash))
+    {
+        return {};
+    }
+
+    std::size_t count = 0u;
+    if (hash)
+    {
+        count = hash[1]; // nchain
+    }
+    else
+    {
+        // The highest bucket leads to the last chain: walk it to its end
+        std::uint32_t nbuckets = gnu_hash[0];
+        std::uint32_t symoffset = gnu_hash[1];
+        std::uint32_t bloom_size = gnu_hash[2];
+        const auto* bloom = reinterpret_cast<const ElfW(Addr)*>(gnu_hash + 4);
+        const auto* buckets =
+            reinterpret_cast<const std::uint32_t*>(bloom + bloom_size);
+        const std::uint32_t* chain = buckets + nbuckets;
+
+        std::uint32_t last = 0u;
+        for (std::uint32_t i = 0u; i < nbuckets; ++i)
+        {
+            last = std::max(last, buckets[i]);
+        }
+        if (last < symoffset)
+        {
+            count = symoffset;
+        }
+        else
+        {
+            while ((chain[last - symoffset] & 1u) == 0u)
+            {
+                ++last;
+            }
+            count = last + 1u;
+        }
+    }
+
+    std::vector<std::string> symbols;
+    for (std::size_t i = 1u; i < count; ++i)
+    {
+        // The ELF64_ST_* macros are the same as the ELF32_ST_* ones
+        const ElfW(Sym)& symbol = symtab[i];
+        unsigned char binding = ELF64_ST_BIND(symbol.st_info);
+        unsigned char type = ELF64_ST_TYPE(symbol.st_info);
+        unsigned char visibility = ELF64_ST_VISIBILITY(symbol.st_other);
+        if ((symbol.st_shndx == SHN_UNDEF) ||
+            ((binding != STB_GLOBAL) && (binding != STB_WEAK) &&
+             (binding != STB_GNU_UNIQUE)) ||
+            (type == STT_SECTION) || (type == STT_FILE) ||
+            ((visibility != STV_DEFAULT) && (visibility != STV_PROTECTED)))
+        {
+            continue;
+        }
+        symbols.emplace_back(strtab + symbol.st_name);
+    }
+
+    // Versioned definitions of the same name appear several times
+    std::sort(symbols.begin(), symbols.end());
+    symbols.erase(std::unique(symbols.begin(), symbols.end()),
+                  symbols.end());
+    return symbols;
+}
+
+//!----------------------------------------------------------------------------
+//! \brief Find the file mapped at an address of the process
+//! \param p_address Address inside the mapping
+//! \param p_signature [out] Device and inode of the mapped file
+//! \return false if the address is not mapped from a file
+//!----------------------------------------------------------------------------
+bool mappedFile(std::uintptr_t p_address, FileSignature& p_signature)
+{
+    std::ifstream maps("/proc/self/maps");
+    std::string line;
+    while (std::getline(maps, line))
+    {
+        unsigned long start, end, inode;
+        unsigned int major_id, minor_id;
+        if ((std::sscanf(line.c_str(),
+                         "%lx-%lx %*s %*s %x:%x %lu",
+                         &start,
+                         &end,
+                         &major_id,
+                         &minor_id,
+                         &inode) == 5) &&
+            (p_address >= start) && (p_address < end))
+        {
+            p_signature.device = makedev(major_id, minor_id);
+            p_signature.inode = inode;
+            return inode != 0u;
+        }
+    }
+    return false;
+}
+
+//! ***************************************************************************
+//! \brief Resident memory of a mapping of the process
+//! ***************************************************************************
+struct ResidentRange
+{
+    std::uintptr_t start;
+    std::uintptr_t end;
+    std::size_t rss;
+};
+
+//!----------------------------------------------------------------------------
+//! \brief Read the resident memory of every mapping of the process
+//! \return The mappings sorted by address
+//!----------------------------------------------------------------------------
+std::vector<ResidentRange> readResidentRanges()
+{
+    std::vector<ResidentRange> ranges;
+    std::ifstream smaps("/proc/self/smaps");
+    std::string line;
+    while (std::getline(smaps, line))
+    {
+        unsigned long start, end;
+        std::size_t kb;
+        if (std::sscanf(line.c_str(), "%lx-%lx ", &start, &end) == 2)
+        {
+            ranges.push_back({ start, end, 0u });
+        }
+        else if (!ranges.empty() &&
+                 (std::sscanf(line.c_str(), "Rss: %zu kB", &kb) == 1))
+        {
+            ranges.back().rss = kb * 1024u;
+        }
+    }
+    return ranges;
+}
+
+//!----------------------------------------------------------------------------
+//! \brief Resident memory of the mappings overlapping [p_start, p_end[
+//! \param p_ranges Mappings sorted by address
+//!----------------------------------------------------------------------------
+std::size_t residentSize(const std::vector<ResidentRange>& p_ranges,
+                         std::uintptr_t p_start,
+                         std::uintptr_t p_end)
+{
+    auto it = std::upper_bound(p_ranges.begin(),
+                               p_ranges.end(),
+                               p_start,
+                               [](std::uintptr_t p_address,
+                                  const ResidentRange& p_range)
+                               { return p_address < p_range.end; });
+    std::size_t rss = 0u;
+    for (; (it != p_ranges.end()) && (it->start < p_end); ++it)
+    {
+        rss += it->rss;
+    }
+    return rss;
+}
+#endif
+
+} // anonymous namespace
+
+//! ***************************************************************************
+//! \brief Implementation of DynamicLibrary
+//! ***************************************************************************
+class DynamicLibrary::Implementation
+{
+public:
+
+    //!------------------------------------------------------------------------
+    //! \brief Library information
+    //!------------------------------------------------------------------------
+    struct LibraryInfo
+    {
+        LibHandle handle = nullptr;
+        std::string path;
+        //! \brief Updated by needsReload() for bit-identical rebuilds
+        mutable FileSignature signature;
+        std::unordered_map<std::string, void*> symbol_cache;
+        LinkNamespace link_namespace = LinkNamespace::Shared;
+        long namespace_id = 0;
+        int fd = -1;
+        bool in_memory = false;
+        bool pending = false;
+        std::size_t huge_text = 0u;
+        std::string build_id;
+        bool symbols_dirty = false;
+        mutable bool reload_capability_tested = false;
+        mutable bool can_reload = true;
+
+        LibraryInfo() = default;
+        LibraryInfo(const LibraryInfo&) = delete;
+        LibraryInfo& operator=(const LibraryInfo&) = delete;
+
+        //!--------------------------------------------------------------------
+        //! \brief Move constructor
+        //!--------------------------------------------------------------------
+        LibraryInfo(LibraryInfo&& p_other) noexcept
+            : handle(p_other.handle),
+              path(std::move(p_other.path)),
+              signature(p_other.signature),
+              symbol_cache(std::move(p_other.symbol_cache)),
+              link_namespace(p_other.link_namespace),
+              namespace_id(p_other.namespace_id),
+              fd(p_other.fd),
+              in_memory(p_other.in_memory),
+              pending(p_other.pending),
+              huge_text(p_other.huge_text),
+              build_id(std::move(p_other.build_id)),
+              symbols_dirty(p_other.symbols_dirty),
+              reload_capability_tested(p_other.reload_capability_tested),
+              can_reload(p_other.can_reload)
+        {
+            p_other.handle = nullptr;
+            p_other.fd = -1;
+        }
+
+        //!--------------------------------------------------------------------
+        //! \brief Move assignment operator
+        //!--------------------------------------------------------------------
+        LibraryInfo& operator=(LibraryInfo&& p_other) noexcept
+        {
+            if (this != &p_other)
+            {
+                handle = p_other.handle;
+                path = std::move(p_other.path);
+                signature = p_other.signature;
+                symbol_cache = std::move(p_other.symbol_cache);
+                link_namespace = p_other.link_namespace;
+                namespace_id = p_other.namespace_id;
+                fd = p_other.fd;
+                in_memory = p_other.in_memory;
+                pending = p_other.pending;
+                huge_text = p_other.huge_text;
+                build_id = std::move(p_other.build_id);
+                symbols_dirty = p_other.symbols_dirty;
+                reload_capability_tested = p_other.reload_capability_tested;
+                can_reload = p_other.can_reload;
+                p_other.handle = nullptr;
+                p_other.fd = -1;
+            }
+            return *this;
+        }
+    };
+
+    LibraryInfo lib;
+    mutable std::mutex mutex;
+    //! \brief Shared by the calls of invokeAll(), exclusive around dlclose():
+    //! the code of the library stays mapped during a call (see lockCode())
+    mutable std::shared_timed_mutex code_mutex;
+    AutoReload auto_reload = AutoReload::Enabled;
+    std::string error_message;
+    //! \brief Also set without the mutex by the calls of invokeAll()
+    std::atomic<std::chrono::steady_clock::time_point> last_use{
+        std::chrono::steady_clock::time_point()
+    };
+    HugePages huge_pages = HugePages::Disabled;
+
+    //!------------------------------------------------------------------------
+    //! \brief State of the library file as reported by the directory watcher
+    //! of a manager, set without lock by the watcher thread.
+    //!------------------------------------------------------------------------
+    enum class FileWatch
+    {
+        None,   //!< Not watched: stat the file to detect changes
+        Clean,  //!< Watched and unchanged since the last check
+        Changed //!< Watched and modified (or state unknown)
+    };
+    mutable std::atomic<FileWatch> file_watch{ FileWatch::None };
+    //! \brief Value of loadEpoch() at the last load or unload
+    std::atomic<std::uint64_t> load_generation{ 0u };
+    mutable OperationMetrics metrics;
+    //! \brief Subscribers of the library, created by the first subscription
+    std::shared_ptr<EventHub> events;
+    //! \brief events, read without lock by the reload path
+    std::atomic<EventHub*> events_hub{ nullptr };
+    //! \brief Guards the creation of events
+    std::mutex events_mutex;
+    //! \brief Subscribers of the manager of the library, and name of the
+    //! library in this manager. Set before the library is shared.
+    std::shared_ptr<EventHub> manager_events;
+    std::string managed_name;
+    //! \brief Events were queued: their delivery is scheduled once the
+    //! library mutex is released
+    mutable std::atomic<bool> events_pending{ false };
+    //! \brief Loader thread of the manager of the library (if any)
+    std::shared_ptr<LoaderQueue> loader;
+    //! \brief Generation of the manager of the library (if any), advanced
+    //! by each load and unload
+    std::shared_ptr<std::atomic<std::uint64_t>> manager_generation;
+
+    //!------------------------------------------------------------------------
+    //! \brief State served to the observers (isLoaded(), getPath()...)
+    //! without the mutex, so that they never wait for a load or a reload.
+    //! Published by the mutators when they release the mutex.
+    //!------------------------------------------------------------------------
+    struct Status
+    {
+        std::string path;
+        std::string error_message;
+        //! \brief Build-id of the loaded build (empty if not loaded)
+        std::string build_id;
+        FileSignature signature;
+        bool in_memory = false;
+    };
+    //! \brief Few stripes: a library has few concurrent observers
+    mutable ReadMostly<Status, 2u> status;
+    mutable std::atomic<bool> loaded{ false };
+
+    //!------------------------------------------------------------------------
+    //! \brief Lock of the mutators: publishes the status on release
+    //!------------------------------------------------------------------------
+    class StatusLock
+    {
+    public:
+
+        explicit StatusLock(const Implementation& p_impl)
+            : m_impl(p_impl), m_lock(p_impl.mutex)
+        {
+        }
+
+        ~StatusLock()
+        {
+            if (m_publish)
+            {
+                m_impl.publishStatus();
+            }
+            m_lock.unlock();
+            if (m_schedule)
+            {
+                m_impl.scheduleEvents();
+            }
+        }
+
+        //! \brief Nothing observable was modified: skip the publication
+        void keepStatus()
+        {
+            m_publish = false;
+        }
+
+        //! \brief Another lock is held: the caller schedules the events
+        //! once it is released
+        void deferEvents()
+        {
+            m_schedule = false;
+        }
+
+    private:
+
+        const Implementation& m_impl;
+        std::unique_lock<std::mutex> m_lock;
+        bool m_publish = true;
+        bool m_schedule = true;
+    };
+
+    //!------------------------------------------------------------------------
+    //! \brief Destructor. Unload the library and release its namespace.
+    //!------------------------------------------------------------------------
+    ~Implementation()
+    {
+        {
+            std::lock_guard<std::mutex> lock(mutex);
+            unloadInternal();
+            closeFile();
+        }
+        scheduleEvents();
+    }
+
+    //! ***********************************************************************
+    //! \brief Marks the calling thread as running the code of a library
+    //! while it is alive (see DynamicLibraryManager::callTarget())
+    //! ***********************************************************************
+    class CallScope
+    {
+    public:
+
+        explicit CallScope(const Implementation& p_impl)
+        {
+            calls().push_back(&p_impl);
+        }
+
+        CallScope(const CallScope&) = delete;
+        CallScope& operator=(const CallScope&) = delete;
+
+        ~CallScope()
+        {
+            calls().pop_back();
+        }
+
+        //! \brief Libraries whose code the calling thread runs, innermost last
+        static std::vector<const Implementation*>& calls()
+        {
+            thread_local std::vector<const Implementation*> libraries;
+            return libraries;
+        }
+    };
+
+    //!------------------------------------------------------------------------
+    //! \brief Check if the calling thread runs the code of the library, which
+    //! cannot be unloaded then: the unload would wait for the call forever.
+    //!------------------------------------------------------------------------
+    bool inOwnCall() const
+    {
+        const auto& calls = CallScope::calls();
+        return std::find(calls.begin(), calls.end(), this) != calls.end();
+    }
+
+    //!------------------------------------------------------------------------
+    //! \brief Take the code lock exclusively, with the mutex held. The calls
+    //! running in the library may need the mutex (e.g. getSymbol()), so it is
+    //! released while they are waited for: the state may have changed once
+    //! this returns.
+    //!------------------------------------------------------------------------
+    std::unique_lock<std::shared_timed_mutex> lockCode()
+    {
+        std::unique_lock<std::shared_timed_mutex> code_lock(code_mutex,
+                                                           std::try_to_lock);
+        if (!code_lock.owns_lock())
+        {
+            mutex.unlock();
+            code_lock.lock();
+            mutex.lock();
+        }
+        return code_lock;
+    }
+
+    //!------------------------------------------------------------------------
+    //! \brief Copy a shared object into a sealed anonymous memory file
+    //! \param p_data Content of the shared object
+    //! \param p_size Size of the buffer
+    //! \param p_name Name of the memory file
+    //! \return The file descriptor, or -1 on error
+    //!------------------------------------------------------------------------
+    int createMemoryFile(const void* p_data,
+                         std::size_t p_size,
+                         const std::string& p_name)
+    {
+        if (!p_data || (p_size == 0u))
+        {
+            error_message = "Library buffer cannot be empty";
+            return -1;
+        }
+
+#if defined(__linux__) && defined(MFD_CLOEXEC)
+        int fd = memfd_create(p_name.c_str(), MFD_CLOEXEC | MFD_ALLOW_SEALING);
+        if (fd < 0)
+        {
+            error_message = "Failed to create memory file for library '" +
+                            p_name + "': " + std::strerror(errno);
+            return -1;
+        }
+
+        const char* data = static_cast<const char*>(p_data);
+        std::size_t written = 0u;
+        while (written < p_size)
+        {
+            ssize_t res = ::write(fd, data + written, p_size - written);
+            if (res < 0)
+            {
+                if (errno == EINTR)
+                {
+                    continue;
+                }
+                error_message = "Failed to write memory file for library '" +
+                                p_name + "': " + std::strerror(errno);
+                ::close(fd);
+                return -1;
+            }
+            written += static_cast<std::size_t>(res);
+        }
+
+        // The code is mapped from this file: forbid any later modification.
+        fcntl(fd,
+              F_ADD_SEALS,
+              F_SEAL_SHRINK | F_SEAL_GROW | F_SEAL_WRITE | F_SEAL_SEAL);
+        return fd;
+#else
+        error_message = "Failed to load library '" + p_name +
+                        "': loading from memory is not supported";
+        return -1;
+#endif
+    }
+
+    //!------------------------------------------------------------------------
+    //! \brief Open the library file once and read its signature from the
+    //! descriptor, so the signature always describes the file which is loaded.
+    //! \param p_path Path of the library
+    //! \param p_fd [out] Descriptor of the opened file (-1 on Windows)
+    //! \param p_signature [out] Signature of the opened file
+    //! \return True if successful, false otherwise
+    //!------------------------------------------------------------------------
+    bool openFile(const std::string& p_path,
+                  int& p_fd,
+                  FileSignature& p_signature)
+    {
+        if (p_path.empty())
+        {
+            error_message = "Library path cannot be empty";
+            return false;
+        }
+
+#ifdef _WIN32
+        std::ifstream file(p_path);
+        if (!file.good())
+        {
+            error_message =
+                "Library file does not exist or is not accessible: " + p_path;
+            return false;
+        }
+        p_fd = -1;
+        p_signature = getFileSignature(p_path);
+        return true;
+#else
+        p_fd = ::open(p_path.c_str(), O_RDONLY | O_CLOEXEC);
+        struct stat file_stat;
+        if ((p_fd < 0) || (fstat(p_fd, &file_stat) != 0))
+        {
+            error_message =
+                "Library file does not exist or is not accessible: " + p_path;
+            if (p_fd >= 0)
+            {
+                ::close(p_fd);
+                p_fd = -1;
+            }
+            return false;
+        }
+        p_signature = toSignature(file_stat);
+        return true;
+#endif
+    }
+
+    //!------------------------------------------------------------------------
+    //! \brief Close the file backing the library, if any
+    //!------------------------------------------------------------------------
+    void closeFile()
+    {
+#ifndef _WIN32
+        if (lib.fd >= 0)
+        {
+#    ifdef __linux__
+            // An object of a memory file which outlived dlclose()
+            // (RTLD_NODELETE, unique symbols ...) is still known by the
+            // loader under its /proc/self/fd name: keep the descriptor open
+            // so this name is never reused for another library.
+            if (lib.in_memory &&
+                (lib.link_namespace == LinkNamespace::Shared) &&
+                loaderCall(
+                    [this]()
+                    {
+                        void* alive = dlopen(loadPath().c_str(),
+                                             RTLD_LAZY | RTLD_NOLOAD);
+                        if (alive)
+                        {
+                            dlclose(alive);
+                        }
+                        return alive != nullptr;
+                    }))
+            {
+                lib.fd = -1;
+            }
+            if (lib.fd >= 0)
+#    endif
+            {
+                ::close(lib.fd);
+            }
+        }
+#endif
+        lib.fd = -1;
+        lib.in_memory = false;
+    }
+
+    //!------------------------------------------------------------------------
+    //! \brief Use an opened file as the source of the library
+    //! \param p_fd Descriptor of the file
+    //! \param p_signature Signature of the file
+    //!------------------------------------------------------------------------
+    void setFile(int p_fd, const FileSignature& p_signature)
+    {
+        lib.fd = p_fd;
+        lib.signature = p_signature;
+    }
+
+    //!------------------------------------------------------------------------
+    //! \brief Use a memory file as the source of the library
+    //! \param p_fd File descriptor returned by createMemoryFile()
+    //! \param p_name Name of the memory file
+    //!------------------------------------------------------------------------
+    void setMemoryFile(int p_fd, const std::string& p_name)
+    {
+        setFile(p_fd, FileSignature());
+        lib.in_memory = true;
+        lib.path = p_name;
+    }
+
+    //!------------------------------------------------------------------------
+    //! \brief Path given to the loader. A memory file has no path: it is
+    //! loaded through its descriptor. A file is loaded by its path, so that
+    //! $ORIGIN, dladdr() and the debuggers see the directory of the library;
+    //! loadedFileMatches() then checks it is the file opened by openFile().
+    //! \return The path to load
+    //!------------------------------------------------------------------------
+    std::string loadPath() const
+    {
+#ifdef __linux__
+        if (lib.in_memory && (lib.fd >= 0))
+        {
+            return "/proc/self/fd/" + std::to_string(lib.fd);
+        }
+#endif
+        return lib.path;
+    }
+
+    //!------------------------------------------------------------------------
+    //! \brief Error of the loader, with the /proc/self/fd name given by
+    //! loadPath() rewritten to the path of the library
+    //! \param p_error Text returned by dlerror(), if any
+    //! \return The error message
+    //!------------------------------------------------------------------------
+    std::string loaderError(const char* p_error) const
+    {
+        if (p_error == nullptr)
+        {
+            return "Unknown error";
+        }
+        std::string error(p_error);
+        const std::string load_path = loadPath();
+        if (load_path != lib.path)
+        {
+            for (std::size_t position = error.find(load_path);
+                 position != std::string::npos;
+                 position = error.find(load_path, position + lib.path.size()))
+            {
+                error.replace(position, load_path.size(), lib.path);
+            }
+        }
+        return error;
+    }
+
+    //!------------------------------------------------------------------------
+    //! \brief Get the signature of the file currently present on disk
+    //! \param p_path Path of the file
+    //! \return The file signature, or an empty signature on error
+    //!------------------------------------------------------------------------
+    static FileSignature getFileSignature(const std::string& p_path)
+    {
+        FileSignature signature;
+#ifdef _WIN32
+        WIN32_FILE_ATTRIBUTE_DATA file_info;
+        if (GetFileAttributesExA(
+                p_path.c_str(), GetFileExInfoStandard, &file_info))
+        {
+            FILETIME ft = file_info.ftLastWriteTime;
+            ULARGE_INTEGER ull;
+            ull.LowPart = ft.dwLowDateTime;
+            ull.HighPart = ft.dwHighDateTime;
+
+            signature.mtime_ns = static_cast<std::int64_t>(
+                (ull.QuadPart - 116444736000000000ULL) * 100);
+            signature.size =
+                (std::uint64_t(file_info.nFileSizeHigh) << 32) |
+                file_info.nFileSizeLow;
+        }
+#elif defined(__linux__) && defined(STATX_BASIC_STATS)
+        // Only ask for the fields of the signature, without forcing a sync
+        // with the server on network file systems.
+        struct statx file_stat;
+        if (statx(AT_FDCWD,
+                  p_path.c_str(),
+                  AT_STATX_DONT_SYNC,
+                  STATX_MTIME | STATX_SIZE | STATX_INO,
+                  &file_stat) == 0)
+        {
+            signature.mtime_ns =
+                std::int64_t(file_stat.stx_mtime.tv_sec) * 1000000000 +
+                file_stat.stx_mtime.tv_nsec;
+            signature.size = file_stat.stx_size;
+            signature.inode = file_stat.stx_ino;
+            signature.device = static_cast<std::uint64_t>(
+                makedev(file_stat.stx_dev_major, file_stat.stx_dev_minor));
+        }
+#else
+        struct stat file_stat;
+        if (stat(p_path.c_str(), &file_stat) == 0)
+        {
+            signature = toSignature(file_stat);
+        }
+#endif
+        return signature;
+    }
+
+    //!------------------------------------------------------------------------
+    //! \brief Give the library a new load generation, after a load or an
+    //! unload, and advance the generation of its manager
+    //!------------------------------------------------------------------------
+    void newGeneration()
+    {
+        load_generation.store(++loadEpoch());
+        if (manager_generation)
+        {
+            manager_generation->fetch_add(1u);
+        }
+    }
+
+    //!------------------------------------------------------------------------
+    //! \brief Run a call to the dynamic loader on the loader thread of the
+    //! manager, when it has one
+    //!------------------------------------------------------------------------
+    template <typename Call>
+    auto loaderCall(Call&& p_call) const -> decltype(p_call())
+    {
+        return loader ? loader->run(std::forward<Call>(p_call)) : p_call();
+    }
+
+    //!------------------------------------------------------------------------
+    //! \brief Load the library. Only the calls to the dynamic loader run on
+    //! the loader thread (see loaderCall()).
+    //!------------------------------------------------------------------------
+    bool loadInternal()
+    {
+        ScopedTimer timer(metrics, Operation::Load);
+
+#ifdef _WIN32
+        DWORD error = 0;
+        lib.handle = loaderCall(
+            [this, &error]()
+            {
+                HMODULE handle = LoadLibraryA(lib.path.c_str());
+                error = handle ? 0 : GetLastError();
+                return handle;
+            });
+        if (!lib.handle)
+        {
+            error_message = "Failed to load library '" + lib.path +
+                            "' (Error: " + std::to_string(error) + ")";
+            return false;
+        }
+#else
+        if (lib.link_namespace == LinkNamespace::Isolated)
+        {
+            if (!loadIsolated())
+            {
+                return false;
+            }
+        }
+        else
+        {
+            // dlerror() is per thread: read by the thread of the call
+            std::string error;
+            lib.handle = loaderCall(
+                [this, &error]()
+                {
+                    void* handle =
+                        dlopen(loadPath().c_str(), RTLD_NOW | RTLD_LOCAL);
+                    if (!handle)
+                    {
+                        error = loaderError(dlerror());
+                    }
+                    return handle;
+                });
+            if (!lib.handle)
+            {
+                error_message =
+                    "Failed to load library '" + lib.path + "': " + error;
+                return false;
+            }
+            lib.namespace_id = 0;
+        }
+#endif
+
+        if (!loadedFileMatches())
+        {
+            return false;
+        }
+        lib.huge_text = (huge_pages == HugePages::Enabled)
+                            ? remapTextOnHugePages()
+                            : 0u;
+        loadSymbolCache();
+        newGeneration();
+        return true;
+    }
+
+    //!------------------------------------------------------------------------
+    //! \brief Check that the object loaded by its path is the file opened by
+    //! openFile(), whose signature was read: the file may have been replaced
+    //! in between. The object is unloaded otherwise.
+    //! \return True if the object is the opened file, false otherwise
+    //!------------------------------------------------------------------------
+    bool loadedFileMatches()
+    {
+#ifdef __linux__
+        struct link_map* map = nullptr;
+        FileSignature mapped;
+        if (lib.in_memory || (lib.fd < 0) ||
+            ((dlinfo(lib.handle, RTLD_DI_LINKMAP, &map) == 0) && map &&
+             mappedFile(reinterpret_cast<std::uintptr_t>(map->l_ld),
+                        mapped) &&
+             (mapped.device == lib.signature.device) &&
+             (mapped.inode == lib.signature.inode)))
+        {
+            return true;
+        }
+
+        loaderCall([this]() { return dlclose(lib.handle); });
+        if (lib.link_namespace == LinkNamespace::Isolated)
+        {
+            NamespaceRegistry::instance().release();
+        }
+        lib.handle = nullptr;
+        lib.namespace_id = 0;
+        error_message = "Failed to load library '" + lib.path +
+                        "': the file was replaced while being loaded";
+        return false;
+#else
+        return true;
+#endif
+    }
+
+    //!------------------------------------------------------------------------
+    //! \brief Path of the persistent symbol cache of the loaded build
+    //! \return The path, or an empty string if there is no cache
+    //!------------------------------------------------------------------------
+    std::string symbolCachePath() const
+    {
+        std::string directory = SymbolCacheSettings::instance().directory();
+        if (directory.empty() || lib.build_id.empty())
+        {
+            return {};
+        }
+        return directory + "/" + lib.build_id + ".symbols";
+    }
+
+    //!------------------------------------------------------------------------
+    //! \brief Read the GNU build-id of the loaded library and fill the symbol
+    //! cache from the persistent cache saved by a previous load of the same
+    //! build. Symbols are stored as offsets from the load base.
+    //!------------------------------------------------------------------------
+    void loadSymbolCache()
+    {
+        lib.build_id.clear();
+        lib.symbols_dirty = false;
+
+#ifdef __linux__
+        struct link_map* map = nullptr;
+        if ((dlinfo(lib.handle, RTLD_DI_LINKMAP, &map) != 0) || !map)
+        {
+            return;
+        }
+        lib.build_id = buildIdOf(map);
+
+        std::string path = symbolCachePath();
+        if (path.empty())
+        {
+            return;
+        }
+
+        std::ifstream file(path);
+        std::string magic, build_id;
+        if (!(file >> magic >> build_id) || (magic != "DLSYMCACHE1") ||
+            (build_id != lib.build_id))
+        {
+            return;
+        }
+
+        std::uintptr_t offset;
+        std::string name;
+        while (file >> std::hex >> offset >> name)
+        {
+            std::uintptr_t address = map->l_addr + offset;
+            if (isInsideObject(map, address))
+            {
+                lib.symbol_cache.emplace(name,
+                                         reinterpret_cast<void*>(address));
+            }
+        }
+#endif
+    }
+
+    //!------------------------------------------------------------------------
+    //! \brief Save the resolved symbols of the library in its persistent
+    //! cache. Symbols resolved from a dependency are not saved since their
+    //! offset depends on where the dependency is loaded.
+    //!------------------------------------------------------------------------
+    void saveSymbolCache()
+    {
+#ifdef __linux__
+        std::string path = symbolCachePath();
+        struct link_map* map = nullptr;
+        if (!lib.symbols_dirty || path.empty() ||
+            (dlinfo(lib.handle, RTLD_DI_LINKMAP, &map) != 0) || !map)
+        {
+            return;
+        }
+
+        std::string tmp_path = temporaryPath(path);
+        {
+            std::ofstream file(tmp_path, std::ios::trunc);
+            file << "DLSYMCACHE1 " << lib.build_id << std::hex << '\n';
+            for (const auto& symbol : lib.symbol_cache)
+            {
+                auto address = reinterpret_cast<std::uintptr_t>(symbol.second);
+                if (isInsideObject(map, address))
+                {
+                    file << (address - map->l_addr) << ' ' << symbol.first
+                         << '\n';
+                }
+            }
+            if (!file.good())
+            {
+                std::remove(tmp_path.c_str());
+                return;
+            }
+        }
+        std::rename(tmp_path.c_str(), path.c_str());
+        lib.symbols_dirty = false;
+#endif
+    }
+
+    //!------------------------------------------------------------------------
+    //! \brief Move the executable segments of the library onto transparent
+    //! huge pages to reduce iTLB misses. The 2 MiB aligned part of each
+    //! segment is copied into an anonymous region advised with
+    //! MADV_HUGEPAGE, which then atomically replaces the file mapping with
+    //! mremap(): on any failure the original mapping is left untouched.
+    //! \note Must run before any code of the library can be executing in
+    //!   another thread, i.e. right after dlopen().
+    //! \return Number of bytes remapped (0 if not possible)
+    //!------------------------------------------------------------------------
+    std::size_t remapTextOnHugePages()
+    {
+        std::size_t remapped = 0u;
+#if defined(__linux__) && defined(MADV_HUGEPAGE) && defined(MREMAP_FIXED)
+        static const std::size_t huge_page_size = hugePageSize();
+        struct link_map* map = nullptr;
+        const ElfW(Phdr)* phdr = nullptr;
+        std::size_t phnum = 0;
+        if ((huge_page_size == 0u) ||
+            (dlinfo(lib.handle, RTLD_DI_LINKMAP, &map) != 0) || !map ||
+            !programHeaders(map, phdr, phnum))
+        {
+            return 0u;
+        }
+
+        const std::uintptr_t mask = ~std::uintptr_t(huge_page_size - 1u);
+        for (std::size_t i = 0; i < phnum; ++i)
+        {
+            if ((phdr[i].p_type != PT_LOAD) || !(phdr[i].p_flags & PF_X))
+            {
+                continue;
+            }
+
+            std::uintptr_t begin = map->l_addr + phdr[i].p_vaddr;
+            std::uintptr_t start = (begin + huge_page_size - 1u) & mask;
+            std::uintptr_t end = (begin + phdr[i].p_memsz) & mask;
+            if (start >= end)
+            {
+                continue; // Segment too small or badly placed
+            }
+
+            std::size_t size = end - start;
+            void* region = allocateHugePageRegion(size, huge_page_size);
+            if (!region)
+            {
+                continue;
+            }
+
+            std::memcpy(region, reinterpret_cast<void*>(start), size);
+            if ((mprotect(region, size, PROT_READ | PROT_EXEC) != 0) ||
+                (mremap(region,
+                        size,
+                        size,
+                        MREMAP_MAYMOVE | MREMAP_FIXED,
+                        reinterpret_cast<void*>(start)) == MAP_FAILED))
+            {
+                munmap(region, size);
+                continue;
+            }
+            remapped += size;
+        }
+#endif
+        return remapped;
+    }
+
+#if defined(__linux__) && defined(MADV_HUGEPAGE)
+    //!------------------------------------------------------------------------
+    //! \brief Size of the transparent huge pages, or 0 when they are disabled
+    //!------------------------------------------------------------------------
+    static std::size_t hugePageSize()
+    {
+        std::ifstream enabled("/sys/kernel/mm/transparent_hugepage/enabled");
+        std::string mode;
+        if (!std::getline(enabled, mode) ||
+            (mode.find("[never]") != std::string::npos))
+        {
+            return 0u;
+        }
+
+        std::size_t size = 0u;
+        std::ifstream pmd("/sys/kernel/mm/transparent_hugepage/hpage_pmd_size");
+        if (!(pmd >> size))
+        {
+            size = 2u * 1024u * 1024u;
+        }
+        return size;
+    }
+
+    //!------------------------------------------------------------------------
+    //! \brief Allocate an anonymous read-write region aligned on a huge page
+    //! boundary and advised to be backed by huge pages
+    //! \return The region, or nullptr on error
+    //!------------------------------------------------------------------------
+    static void* allocateHugePageRegion(std::size_t p_size,
+                                        std::size_t p_alignment)
+    {
+        std::size_t length = p_size + p_alignment;
+        void* raw = mmap(nullptr,
+                         length,
+                         PROT_READ | PROT_WRITE,
+                         MAP_PRIVATE | MAP_ANONYMOUS,
+                         -1,
+                         0);
+        if (raw == MAP_FAILED)
+        {
+            return nullptr;
+        }
+
+        // Trim the mapping down to the aligned part
+        std::uintptr_t address = reinterpret_cast<std::uintptr_t>(raw);
+        std::uintptr_t aligned =
+            (address + p_alignment - 1u) & ~std::uintptr_t(p_alignment - 1u);
+        if (aligned > address)
+        {
+            munmap(raw, aligned - address);
+        }
+        std::size_t tail = (address + length) - (aligned + p_size);
+        if (tail > 0u)
+        {
+            munmap(reinterpret_cast<void*>(aligned + p_size), tail);
+        }
+
+        void* region = reinterpret_cast<void*>(aligned);
+        if (madvise(region, p_size, MADV_HUGEPAGE) != 0)
+        {
+            munmap(region, p_size);
+            return nullptr;
+        }
+        return region;
+    }
+#endif
+
+    //!------------------------------------------------------------------------
+    //! \brief Load the library into a new link-map namespace
+    //! \return True if successful, false otherwise
+    //!------------------------------------------------------------------------
+    bool loadIsolated()
+    {
+#ifdef LM_ID_NEWLM
+        if (!NamespaceRegistry::instance().acquire())
+        {
+            error_message =
+                "Failed to load library '" + lib.path +
+                "': no more isolated namespaces available (limit: " +
+                std::to_string(NamespaceRegistry::instance().limit()) + ")";
+            return false;
+        }
+
+        std::string error;
+        lib.handle = loaderCall(
+            [this, &error]()
+            {
+                void* handle = dlmopen(
+                    LM_ID_NEWLM, loadPath().c_str(), RTLD_NOW | RTLD_LOCAL);
+                if (!handle)
+                {
+                    error = loaderError(dlerror());
+                }
+                return handle;
+            });
+        if (!lib.handle)
+        {
+            NamespaceRegistry::instance().release();
+            error_message = "Failed to load library '" + lib.path +
+                            "' in a new namespace: " + error;
+            return false;
+        }
+
+        Lmid_t lmid = LM_ID_BASE;
+        dlinfo(lib.handle, RTLD_DI_LMID, &lmid);
+        lib.namespace_id = static_cast<long>(lmid);
+        return true;
+#else
+        error_message = "Failed to load library '" + lib.path +
+                        "': isolated namespaces are not supported";
+        return false;
+#endif
+    }
+
+    //!------------------------------------------------------------------------
+    //! \brief Subscribers of the library, created on first use
+    //!------------------------------------------------------------------------
+    EventHub& eventHub()
+    {
+        std::lock_guard<std::mutex> lock(events_mutex);
+        if (!events)
+        {
+            events = std::make_shared<EventHub>(LIBRARY_EVENTS);
+            events_hub.store(events.get(), std::memory_order_release);
+        }
+        return *events;
+    }
+
+    //!------------------------------------------------------------------------
+    //! \brief Queue an event for the subscribers of the library and of its
+    //! manager. Costs two loads when nobody listens.
+    //!------------------------------------------------------------------------
+    void publish(LibraryEvent p_event) const
+    {
+        EventHub* hubs[] = { events_hub.load(std::memory_order_acquire),
+                             manager_events.get() };
+        for (EventHub* hub : hubs)
+        {
+            if (!hub || !hub->active())
+            {
+                continue;
+            }
+            LibraryNotification notification;
+            notification.event = p_event;
+            notification.library = managed_name;
+            notification.path = lib.path;
+            if (p_event == LibraryEvent::ReloadFailed)
+            {
+                notification.error_message = error_message;
+            }
+            hub->publish(std::move(notification));
+            events_pending.store(true, std::memory_order_release);
+        }
+    }
+
+    //!------------------------------------------------------------------------
+    //! \brief Hand the queued events to the executors. Called without the
+    //! library mutex: an inline executor runs the subscribers right away.
+    //!------------------------------------------------------------------------
+    void scheduleEvents() const
+    {
+        if (!events_pending.exchange(false, std::memory_order_acq_rel))
+        {
+            return;
+        }
+        if (EventHub* hub = events_hub.load(std::memory_order_acquire))
+        {
+            hub->schedule();
+        }
+        if (manager_events)
+        {
+            manager_events->schedule();
+        }
+    }
+
+    //!------------------------------------------------------------------------
+    //! \brief Unload the library. Only the call to the dynamic loader runs on
+    //! the loader thread (see loaderCall()).
+    //! \param p_notify Publish the Unloaded event (not when reloading)
+    //! \return True if successful, false otherwise
+    //!------------------------------------------------------------------------
+    bool unloadInternal(bool p_notify = true)
+    {
+        if (!lib.handle)
+            return true;
+
+        // First, as the mutex may be released meanwhile
+        auto code_lock = lockCode();
+        if (!lib.handle)
+        {
+            return true;
+        }
+
+        ScopedTimer timer(metrics, Operation::Unload);
+        saveSymbolCache();
+        lib.symbol_cache.clear();
+        newGeneration();
+
+#ifdef _WIN32
+        DWORD error = 0;
+        bool success = loaderCall(
+            [this, &error]()
+            {
+                bool freed = FreeLibrary(lib.handle);
+                error = freed ? 0 : GetLastError();
+                return freed;
+            });
+        if (!success)
+        {
+            error_message = "Failed to unload library '" + lib.path +
+                            "' (Error: " + std::to_string(error) + ")";
+        }
+        lib.handle = nullptr;
+        if (p_notify)
+        {
+            publish(LibraryEvent::Unloaded);
+        }
+        return success;
+#else
+        std::string error;
+        bool success = loaderCall(
+            [this, &error]()
+            {
+                if (dlclose(lib.handle) == 0)
+                {
+                    return true;
+                }
+                error = loaderError(dlerror());
+                return false;
+            });
+        if (!success)
+        {
+            error_message =
+                "Failed to unload library '" + lib.path + "': " + error;
+        }
+        if (lib.link_namespace == LinkNamespace::Isolated)
+        {
+            NamespaceRegistry::instance().release();
+        }
+        lib.handle = nullptr;
+        lib.namespace_id = 0;
+        lib.huge_text = 0u;
+        if (p_notify)
+        {
+            publish(LibraryEvent::Unloaded);
+        }
+        return success;
+#endif
+    }
+
+    //!------------------------------------------------------------------------
+    //! \brief Unload the library until its next use. The mutex is held.
+    //! \return True if successful, false otherwise
+    //!------------------------------------------------------------------------
+    bool evict()
+    {
+        if (!lib.handle)
+        {
+            error_message = "Library not loaded";
+            return false;
+        }
+        if (inOwnCall())
+        {
+            error_message = "Library '" + lib.path +
+                            "' cannot be evicted by one of its functions";
+            return false;
+        }
+        if (lib.in_memory)
+        {
+            error_message = "Library loaded from memory cannot be evicted";
+            return false;
+        }
+        if (!canReload())
+        {
+            error_message =
+                "Library cannot be evicted - reload capability not supported";
+            return false;
+        }
+
+        // Keep the signature of the evicted build: a file modified meanwhile
+        // is still reported by checkForUpdates().
+        FileSignature signature = lib.signature;
+        bool success = unloadInternal();
+        closeFile();
+        lib.signature = signature;
+        lib.pending = true;
+        return success;
+    }
+
+    //!------------------------------------------------------------------------
+    //! \brief Get a symbol from the library
+    //! \param p_symbol_name Name of the symbol to get
+    //! \return The symbol
+    //!------------------------------------------------------------------------
+    void* getSymbolInternal(const std::string& p_symbol_name)
+    {
+#ifdef _WIN32
+        void* symbol = reinterpret_cast<void*>(
+            GetProcAddress(lib.handle, p_symbol_name.c_str()));
+        if (!symbol)
+        {
+            error_message = "Symbol '" + p_symbol_name +
+                            "' not found in library '" + lib.path + "'";
+        }
+        return symbol;
+#else
+        dlerror(); // Clear any previous error
+        void* symbol = dlsym(lib.handle, p_symbol_name.c_str());
+        char* error = dlerror();
+        if (error)
+        {
+            error_message = "Symbol '" + p_symbol_name +
+                            "' not found in library '" + lib.path +
+                            "': " + loaderError(error);
+            return nullptr;
+        }
+        return symbol;
+#endif
+    }
+
+    //!------------------------------------------------------------------------
+    //! \brief Look up a symbol without reporting its absence
+    //! \return The symbol, nullptr if not found
+    //!------------------------------------------------------------------------
+    void* findSymbol(const std::string& p_symbol_name) const
+    {
+#ifdef _WIN32
+        return reinterpret_cast<void*>(
+            GetProcAddress(lib.handle, p_symbol_name.c_str()));
+#else
+        dlerror(); // Clear any previous error
+        void* symbol = dlsym(lib.handle, p_symbol_name.c_str());
+        return dlerror() ? nullptr : symbol;
+#endif
+    }
+
+    //!------------------------------------------------------------------------
+    //! \brief List the symbols exported by the loaded library
+    //!------------------------------------------------------------------------
+    std::vector<std::string> exportedSymbols() const
+    {
+#ifdef __linux__
+        struct link_map* map = nullptr;
+        if (lib.handle && (dlinfo(lib.handle, RTLD_DI_LINKMAP, &map) == 0) &&
+            map)
+        {
+            return dl::exportedSymbols(map);
+        }
+#endif
+        return {};
+    }
+
+    //!------------------------------------------------------------------------
+    //! \brief Publish the observable state. Called with the mutex held.
+    //!------------------------------------------------------------------------
+    void publishStatus() const
+    {
+        static const std::string none;
+        const std::string& build_id = lib.handle ? lib.build_id : none;
+
+        loaded.store(lib.handle != nullptr, std::memory_order_release);
+        const Status& current = status.get();
+        if ((current.path == lib.path) &&
+            (current.error_message == error_message) &&
+            (current.build_id == build_id) &&
+            (current.signature == lib.signature) &&
+            (current.in_memory == lib.in_memory))
+        {
+            return;
+        }
+        status.update(
+            [&](Status& p_status)
+            {
+                p_status.path = lib.path;
+                p_status.error_message = error_message;
+                p_status.build_id = build_id;
+                p_status.signature = lib.signature;
+                p_status.in_memory = lib.in_memory;
+            });
+    }
+
+    //!------------------------------------------------------------------------
+    //! \brief Check if a library file differs from the loaded build
+    //! \param p_path Path of the library file
+    //! \param p_signature Signature of the file of the loaded build
+    //! \param p_build_id Build-id of the loaded build (empty if not loaded)
+    //! \param p_current Set to the signature of the modified file
+    //! \param p_same_build Set when the file was modified but holds the
+    //!   loaded build (e.g. bit-identical relink)
+    //! \return True if the library needs to be reloaded, false otherwise
+    //!------------------------------------------------------------------------
+    bool fileChanged(const std::string& p_path,
+                     const FileSignature& p_signature,
+                     const std::string& p_build_id,
+                     FileSignature& p_current,
+                     bool& p_same_build) const
+    {
+        // A watched file is only stat'ed after a change notification. The
+        // state is cleared before the check, so that a notification arriving
+        // meanwhile is not lost.
+        FileWatch watch = FileWatch::Changed;
+        if (!file_watch.compare_exchange_strong(watch, FileWatch::Clean) &&
+            (watch == FileWatch::Clean))
+        {
+            return false;
+        }
+
+        p_current = getFileSignature(p_path);
+        if (p_current == p_signature)
+        {
+            return false;
+        }
+
+#ifdef __linux__
+        if (!p_build_id.empty())
+        {
+            int fd = ::open(p_path.c_str(), O_RDONLY | O_CLOEXEC);
+            p_same_build = (fd >= 0) && (buildIdOfFile(fd) == p_build_id);
+            if (fd >= 0)
+            {
+                ::close(fd);
+            }
+            if (p_same_build)
+            {
+                return false;
+            }
+        }
+#else
+        (void) p_build_id;
+#endif
+        if (watch != FileWatch::None)
+        {
+            // Still to be reported until the library is reloaded, unless
+            // it was meanwhile loaded from a path no longer watched
+            FileWatch clean = FileWatch::Clean;
+            file_watch.compare_exchange_strong(clean, FileWatch::Changed);
+        }
+        return true;
+    }
+
+    //!------------------------------------------------------------------------
+    //! \brief Check if the library needs to be reloaded. Called with the
+    //! mutex held.
+    //! \return True if the library needs to be reloaded, false otherwise
+    //!------------------------------------------------------------------------
+    bool needsReload() const
+    {
+        if (lib.in_memory)
+        {
+            // Sealed memory files never change
+            return false;
+        }
+
+        static const std::string none;
+        FileSignature current;
+        bool same_build = false;
+        if (fileChanged(lib.path,
+                        lib.signature,
+                        lib.handle ? lib.build_id : none,
+                        current,
+                        same_build))
+        {
+            return true;
+        }
+
+        // A relinked but bit-identical build: only record its signature
+        if (same_build)
+        {
+            lib.signature = current;
+        }
+        return false;
+    }
+
+    //!------------------------------------------------------------------------
+    //! \brief needsReload() for the observers: checks a copy of the published
+    //! status, without the mutex and outside of the reader section. A
+    //! bit-identical rebuild is only recorded when the mutex is free: the
+    //! file is marked as changed again otherwise, so that the next call
+    //! repeats the check.
+    //!------------------------------------------------------------------------
+    bool observeUpdates() const
+    {
+        if (file_watch.load(std::memory_order_acquire) == FileWatch::Clean)
+        {
+            return false;
+        }
+
+        Status checked = status.read([](const Status& p_status)
+                                     { return p_status; });
+        if (checked.in_memory)
+        {
+            return false;
+        }
+
+        FileSignature current;
+        bool same_build = false;
+        bool changed = fileChanged(checked.path,
+                                   checked.signature,
+                                   checked.build_id,
+                                   current,
+                                   same_build);
+        if (same_build)
+        {
+            std::unique_lock<std::mutex> lock(mutex, std::try_to_lock);
+            if (lock.owns_lock() && (lib.signature == checked.signature))
+            {
+                lib.signature = current;
+                publishStatus();
+            }
+            else
+            {
+                FileWatch clean = FileWatch::Clean;
+                file_watch.compare_exchange_strong(clean, FileWatch::Changed);
+            }
+        }
+        return changed;
+    }
+
+    //!------------------------------------------------------------------------
+    //! \brief Test if the library can be reloaded (lazy evaluation)
+    //! \return True if the library can be reloaded, false otherwise
+    //!------------------------------------------------------------------------
+    bool canReload() const
+    {
+        if (!lib.handle || lib.reload_capability_tested)
+        {
+            return lib.can_reload;
+        }
+
+        // Test once in a non-destructive way
+        lib.reload_capability_tested = true;
+        ScopedTimer timer(metrics, Operation::ReloadProbe);
+        return loaderCall([this]() { return probeReload(); });
+    }
+
+    //!------------------------------------------------------------------------
+    //! \brief Test the reload capability on the calling thread
+    //! \return True if the library can be reloaded, false otherwise
+    //!------------------------------------------------------------------------
+    bool probeReload() const
+    {
+
+#ifdef _WIN32
+        // On can test by incrementing/decrementing the reference counter
+        HMODULE test_handle = LoadLibraryA(lib.path.c_str());
+        if (test_handle)
+        {
+            bool can_free = FreeLibrary(test_handle);
+            lib.can_reload = can_free;
+        }
+        else
+        {
+            lib.can_reload = false;
+        }
+#else
+        // On test with RTLD_NOLOAD to see if the lib is already loaded
+        // then we try a quick dlopen/dlclose
+        void* test_handle = nullptr;
+#    ifdef LM_ID_NEWLM
+        if (lib.link_namespace == LinkNamespace::Isolated)
+        {
+            // Probe inside the namespace owning the library: a plain dlopen()
+            // would look for it (and load it) in the base namespace.
+            test_handle = dlmopen(static_cast<Lmid_t>(lib.namespace_id),
+                                  loadPath().c_str(),
+                                  RTLD_NOW | RTLD_NOLOAD);
+            lib.can_reload = test_handle && (dlclose(test_handle) == 0);
+            return lib.can_reload;
+        }
+#    endif
+        test_handle = dlopen(loadPath().c_str(), RTLD_NOW | RTLD_NOLOAD);
+        if (test_handle)
+        {
+            // La lib est déjà en mémoire, on peut tester dlclose
+            lib.can_reload = (dlclose(test_handle) == 0);
+        }
+        else
+        {
+            // Not in memory yet, we do a quick test
+            test_handle = dlopen(loadPath().c_str(), RTLD_NOW | RTLD_LOCAL);
+            if (test_handle)
+            {
+                lib.can_reload = (dlclose(test_handle) == 0);
+            }
+            else
+            {
+                lib.can_reload = false;
+            }
+        }
+#endif
+
+        return lib.can_reload;
+    }
+
+    //!------------------------------------------------------------------------
+    //! \brief Reload the library, even when the file holds the loaded build:
+    //! bit-identical rebuilds are only skipped by needsReload(), for the
+    //! automatic reloads.
+    //! \return True if successful, false otherwise
+    //!------------------------------------------------------------------------
+    bool reloadInternal()
+    {
+        if (inOwnCall())
+        {
+            error_message = "Library '" + lib.path +
+                            "' cannot be reloaded by one of its functions";
+            return false;
+        }
+
+        // First check if the reload is possible
+        if (!canReload())
+        {
+            error_message =
+                "Library cannot be reloaded - reload capability not supported";
+            return false;
+        }
+
+        ScopedTimer timer(metrics, Operation::Reload);
+        std::string path = lib.path;
+
+        // Open the new file before unloading: on error the current build
+        // stays loaded. Memory files are reloaded from the same descriptor.
+        int fd = lib.fd;
+        FileSignature signature = lib.signature;
+        if (!lib.in_memory && !openFile(path, fd, signature))
+        {
+            error_message =
+                "Failed to reload library '" + path + "': " + error_message;
+            return false;
+        }
+
+        // Attempt to unload
+        publish(LibraryEvent::PreReload);
+        if (!unloadInternal(false))
+        {
+            error_message = "Warning: Unload failed, attempting reload anyway";
+        }
+
+        if (!lib.in_memory)
+        {
+            closeFile();
+            setFile(fd, signature);
+        }
+
+        // Small pause to let the system stabilize
+        std::this_thread::sleep_for(std::chrono::milliseconds(10));
+
+        // Reload
+        bool success = loadInternal();
+        if (!success)
+        {
+            error_message =
+                "Failed to reload library '" + path + "': " + error_message;
+        }
+        publish(success ? LibraryEvent::PostReload
+                        : LibraryEvent::ReloadFailed);
+
+        return success;
+    }
+
+    //!------------------------------------------------------------------------
+    //! \brief Replace the loaded build by the one loaded by another library,
+    //! which is left empty. The new build being loaded before the current
+    //! one is unloaded, a failure to load it leaves the current one in
+    //! place. Called with the mutex held; the other library is not shared.
+    //! \param p_staged Library holding the new build
+    //!------------------------------------------------------------------------
+    void replaceBuild(Implementation& p_staged)
+    {
+        ScopedTimer timer(metrics, Operation::Reload);
+
+        publish(LibraryEvent::PreReload);
+        if (!unloadInternal(false))
+        {
+            error_message =
+                "Warning: Unload failed, replacing the build anyway";
+        }
+        closeFile();
+
+        lib = std::move(p_staged.lib);
+        newGeneration();
+        last_use.store(std::chrono::steady_clock::now());
+        publish(LibraryEvent::PostReload);
+    }
+
+    //!------------------------------------------------------------------------
+    //! \brief Load a library registered with loadLazy()
+    //! \return True if successful, false otherwise
+    //!------------------------------------------------------------------------
+    bool loadPending()
+    {
+        int fd = -1;
+        FileSignature signature;
+        if (!openFile(lib.path, fd, signature))
+        {
+            return false;
+        }
+
+        setFile(fd, signature);
+        if (!loadInternal())
+        {
+            closeFile();
+            return false;
+        }
+
+        lib.pending = false;
+        return true;
+    }
+
+    //!------------------------------------------------------------------------
+    //! \brief Size of the loadable segments of the library
+    //!------------------------------------------------------------------------
+    std::size_t mappedSize() const
+    {
+#ifdef __linux__
+        struct link_map* map = nullptr;
+        if (lib.handle && (dlinfo(lib.handle, RTLD_DI_LINKMAP, &map) == 0) &&
+            map)
+        {
+            return loadedSize(map);
+        }
+#endif
+        return 0u;
+    }
+
+#ifdef __linux__
+    //!------------------------------------------------------------------------
+    //! \brief Compute the memory footprint of the library
+    //! \param p_ranges Resident memory of the mappings of the process
+    //! \return The memory footprint
+    //!------------------------------------------------------------------------
+    MemoryFootprint
+    memoryFootprint(const std::vector<ResidentRange>& p_ranges) const
+    {
+        MemoryFootprint footprint;
+
+        struct link_map* map = nullptr;
+        const ElfW(Phdr)* phdr = nullptr;
+        std::size_t phnum = 0;
+        if (!lib.handle || (dlinfo(lib.handle, RTLD_DI_LINKMAP, &map) != 0) ||
+            !map || !programHeaders(map, phdr, phnum))
+        {
+            return footprint;
+        }
+
+        for (std::size_t i = 0; i < phnum; ++i)
+        {
+            const ElfW(Phdr)& segment = phdr[i];
+            if (segment.p_type == PT_TLS)
+            {
+                footprint.tls += segment.p_memsz;
+                continue;
+            }
+            if (segment.p_type != PT_LOAD)
+            {
+                continue;
+            }
+
+            if (segment.p_flags & PF_X)
+            {
+                footprint.text += segment.p_memsz;
+            }
+            else if (segment.p_flags & PF_W)
+            {
+                footprint.data += segment.p_filesz;
+                footprint.bss += segment.p_memsz - segment.p_filesz;
+            }
+            else
+            {
+                footprint.rodata += segment.p_memsz;
+            }
+
+            std::uintptr_t start = map->l_addr + segment.p_vaddr;
+            footprint.resident +=
+                residentSize(p_ranges, start, start + segment.p_memsz);
+        }
+        return footprint;
+    }
+#endif
+
+    //!------------------------------------------------------------------------
+    //! \brief Compute the memory cost of the namespace of the library
+    //! \return The namespace report
+    //!------------------------------------------------------------------------
+    NamespaceReport namespaceReport() const
+    {
+        NamespaceReport report;
+        report.id = lib.namespace_id;
+        report.library = lib.path;
+
+#if defined(__linux__)
+        struct link_map* map = nullptr;
+        if (!lib.handle || (dlinfo(lib.handle, RTLD_DI_LINKMAP, &map) != 0) ||
+            !map)
+        {
+            return report;
+        }
+
+        // All the objects of a namespace are chained in the same link map.
+        while (map->l_prev)
+        {
+            map = map->l_prev;
+        }
+
+        for (; map; map = map->l_next)
+        {
+            ++report.objects;
+            report.mapped_bytes += loadedSize(map);
+        }
+#endif
+        return report;
+    }
+
+}; // DynamicLibrary::Implementation
+
+//! ***************************************************************************
+//! \brief Implementation of DynamicLibraryManager
+//! ***************************************************************************
+class DynamicLibraryManager::Implementation
+{
+public:
+
+    //!------------------------------------------------------------------------
+    //! \brief Managed libraries: slot map addressed by LibraryHandle, and
+    //! index of the slots by library name
+    //!------------------------------------------------------------------------
+    struct Libraries
+    {
+        struct Slot
+        {
+            std::shared_ptr<DynamicLibrary> library;
+            //! \brief Incremented each time the slot is freed
+            std::uint32_t generation = 0u;
+        };
+
+        std::unordered_map<std::string, std::uint32_t> names;
+        std::vector<Slot> slots;
+        std::vector<std::uint32_t> free_slots;
+
+        const std::shared_ptr<DynamicLibrary>*
+        find(const std::string& p_name) const
+        {
+            auto it = names.find(p_name);
+            return (it != names.end()) ? &slots[it->second].library : nullptr;
+        }
+
+        LibraryHandle handle(const std::string& p_name) const
+        {
+            LibraryHandle handle;
+            auto it = names.find(p_name);
+            if (it != names.end())
+            {
+                handle.index = it->second;
+                handle.generation = slots[it->second].generation;
+            }
+            return handle;
+        }
+
+        std::shared_ptr<DynamicLibrary> get(LibraryHandle p_handle) const
+        {
+            if (p_handle.isValid() && (p_handle.index < slots.size()) &&
+                (slots[p_handle.index].generation == p_handle.generation))
+            {
+                return slots[p_handle.index].library;
+            }
+            return nullptr;
+        }
+
+        //! \brief Whether the library of a valid handle is being evicted:
+        //! its slot is empty until the eviction ends, under m_mutex
+        bool retired(LibraryHandle p_handle) const
+        {
+            return p_handle.isValid() && (p_handle.index < slots.size()) &&
+                   (slots[p_handle.index].generation == p_handle.generation) &&
+                   !slots[p_handle.index].library;
+        }
+
+        LibraryHandle insert(const std::string& p_name,
+                             std::shared_ptr<DynamicLibrary> p_library)
+        {
+            erase(p_name);
+
+            std::uint32_t index;
+            if (!free_slots.empty())
+            {
+                index = free_slots.back();
+                free_slots.pop_back();
+            }
+            else
+            {
+                index = static_cast<std::uint32_t>(slots.size());
+                slots.emplace_back();
+            }
+
+            Slot& slot = slots[index];
+            slot.library = std::move(p_library);
+            if (slot.generation == 0u)
+            {
+                slot.generation = 1u;
+            }
+            names[p_name] = index;
+            return LibraryHandle{ index, slot.generation };
+        }
+
+        void erase(const std::string& p_name)
+        {
+            auto it = names.find(p_name);
+            if (it == names.end())
+            {
+                return;
+            }
+
+            // Handles taken on the slot become stale
+            Slot& slot = slots[it->second];
+            slot.library.reset();
+            if (++slot.generation == 0u)
+            {
+                slot.generation = 1u;
+            }
+            free_slots.push_back(it->second);
+            names.erase(it);
+        }
+    };
+
+    //! \brief Managed libraries, looked up without lock. They are only
+    //! modified under m_mutex.
+    ReadMostly<Libraries> m_libraries;
+    //! \brief Hash of the archive entry each library was loaded from
+    std::unordered_map<std::string, std::uint64_t> m_archive_hashes;
+    //! \brief Serializes the modifications of the manager
+    mutable std::mutex m_mutex;
+    //! \brief Libraries which published events under m_mutex: scheduled
+    //! by scheduleEvents() once it is released
+    std::vector<std::shared_ptr<DynamicLibrary>> m_pending_events;
+    //! \brief Names whose library is loaded with m_mutex released (see
+    //! Reservation)
+    std::unordered_set<std::string> m_loading;
+    //! \brief Notified when names leave m_loading
+    std::condition_variable m_loaded;
+
+    //!------------------------------------------------------------------------
+    //! \brief Directory searched for libraries given by their short name
+    //!------------------------------------------------------------------------
+    struct SearchDirectory
+    {
+        std::string path;
+        //! \brief Watch descriptor, -1 while the directory cannot be watched
+        int watch = -1;
+        //! \brief Next attempt to watch the directory when it has no watch
+        std::chrono::steady_clock::time_point retry;
+        std::unordered_set<std::string> files;
+    };
+
+    //! \brief Delay between two attempts to watch a missing directory
+    static constexpr std::chrono::seconds WATCH_RETRY{ 1 };
+
+    //! \brief Search directories, by decreasing priority
+    std::vector<SearchDirectory> m_search_directories;
+    //! \brief Cache of resolved short names: name -> path of the library
+    std::unordered_map<std::string, std::string> m_resolved;
+
+    //!------------------------------------------------------------------------
+    //! \brief Change of a watched directory, for the search path cache
+    //!------------------------------------------------------------------------
+    struct DirectoryEvent
+    {
+        int watch;
+        std::uint32_t mask;
+        std::string file;
+    };
+
+    //! \brief Managed libraries of a watched directory, by file name
+    struct WatchedLibrary
+    {
+        std::string name;
+        std::weak_ptr<DynamicLibrary> library;
+        //! \brief The file is a symbolic link on the path of the library
+        bool link;
+    };
+    using WatchedFiles =
+        std::unordered_map<std::string, std::vector<WatchedLibrary>>;
+    //! \brief Watched directories, by watch descriptor. Each directory is
+    //! shared between the versions, so that a modification only copies the
+    //! files of one directory.
+    using WatchedDirectories =
+        std::unordered_map<int, std::shared_ptr<const WatchedFiles>>;
+
+    //! \brief inotify instance watching the search directories and the
+    //! directories of the managed libraries (never the files themselves)
+    int m_inotify_fd = -1;
+    //! \brief eventfd waking the watcher thread up to stop it
+    int m_wake_fd = -1;
+    //! \brief Thread reading the inotify events
+    std::thread m_watcher;
+    //! \brief Serializes the readers of the inotify events
+    std::mutex m_read_mutex;
+    //! \brief Capacity of m_directory_events
+    static constexpr std::size_t DIRECTORY_EVENTS = 1024u;
+    //! \brief Changes of the search directories, applied by resolve()
+    BoundedQueue<DirectoryEvent> m_directory_events{ DIRECTORY_EVENTS };
+    //! \brief Set when m_directory_events was full: the search directories
+    //! are scanned again as a whole
+    std::atomic<bool> m_directory_overflow{ false };
+    //! \brief Watch descriptors of the search directories, read by the
+    //! watcher thread to only queue their events
+    ReadMostly<std::vector<int>> m_search_watches;
+    //! \brief Libraries notified by the watcher thread, read without lock
+    ReadMostly<WatchedDirectories> m_watched;
+    //! \brief Watch descriptors and file names of each watched library: its
+    //! path, and the targets of the symbolic links it goes through
+    std::unordered_map<std::string, std::vector<std::pair<int, std::string>>>
+        m_library_watches;
+
+    //!------------------------------------------------------------------------
+    //! \brief Library exporting a symbol, in the symbol index
+    //!------------------------------------------------------------------------
+    struct SymbolProvider
+    {
+        int priority;
+        std::string name;
+        std::shared_ptr<DynamicLibrary> library;
+    };
+
+    //!------------------------------------------------------------------------
+    //! \brief State of a library in the symbol index
+    //!------------------------------------------------------------------------
+    struct IndexedLibrary
+    {
+        std::shared_ptr<DynamicLibrary> library;
+        std::uint64_t generation = 0u;
+        std::vector<std::string> symbols;
+    };
+
+    //! \brief Providers of each exported symbol, by decreasing priority
+    std::unordered_map<std::string, std::vector<SymbolProvider>> m_symbols;
+    //! \brief Libraries in the symbol index, by name
+    std::unordered_map<std::string, IndexedLibrary> m_indexed_libraries;
+    //! \brief Priorities of the libraries as providers (default: 0)
+    std::unordered_map<std::string, int> m_priorities;
+    //! \brief Advanced each time a managed library is added, removed, loaded
+    //! or unloaded: the symbol index and the resolved functions are only
+    //! refreshed by the changes of this manager
+    std::shared_ptr<std::atomic<std::uint64_t>> m_generation =
+        std::make_shared<std::atomic<std::uint64_t>>(1u);
+    //! \brief Value of m_generation the symbol index is up to date with
+    std::uint64_t m_symbols_generation = 0u;
+    //! \brief Guards the symbol index: shared by the lookups
+    mutable std::shared_timed_mutex m_symbols_mutex;
+    //! \brief Maximum size of the loaded libraries (0: no limit)
+    std::size_t m_memory_budget = 0u;
+    //! \brief Minimum time without use before a library can be evicted
+    std::chrono::milliseconds m_min_idle{ 1000 };
+    //! \brief Subscribers of the events of the managed libraries
+    std::shared_ptr<EventHub> m_events =
+        std::make_shared<EventHub>(MANAGER_EVENTS);
+    //! \brief Thread running the loader calls of the managed libraries
+    std::shared_ptr<LoaderQueue> m_loader = std::make_shared<LoaderQueue>();
+    //! \brief Recording of the metrics of the managed libraries
+    MetricsRecording m_metrics_recording = MetricsRecording::Enabled;
+
+    //!------------------------------------------------------------------------
+    //! \brief Providers of a function resolved by invokeAll()
+    //!------------------------------------------------------------------------
+    struct ResolvedFunction
+    {
+        //! \brief Value of m_generation before the resolution
+        std::uint64_t generation = 0u;
+        std::shared_ptr<const std::vector<FunctionTarget>> targets;
+    };
+
+    //! \brief Functions resolved by invokeAll(), by name
+    std::unordered_map<std::string, ResolvedFunction> m_functions;
+    std::mutex m_functions_mutex;
+    //! \brief Pool running the parallel calls of invokeAll() and the scans,
+    //! started at its first use (see pool())
+    std::unique_ptr<WorkStealingPool> m_pool;
+    std::once_flag m_pool_once;
+
+#ifdef __linux__
+    //! \brief Events watched on the directories
+    static constexpr std::uint32_t WATCH_MASK =
+        IN_CREATE | IN_DELETE | IN_MOVED_FROM | IN_MOVED_TO | IN_CLOSE_WRITE |
+        IN_ATTRIB | IN_DELETE_SELF | IN_MOVE_SELF | IN_ONLYDIR;
+    //! \brief Events changing the list of files of a directory
+    static constexpr std::uint32_t LISTING_MASK =
+        IN_CREATE | IN_DELETE | IN_MOVED_FROM | IN_MOVED_TO | IN_DELETE_SELF |
+        IN_MOVE_SELF | IN_IGNORED | IN_Q_OVERFLOW;
+#endif
+
+    //!------------------------------------------------------------------------
+    //! \brief Constructor. Start the watcher thread.
+    //!------------------------------------------------------------------------
+    Implementation()
+    {
+#ifdef __linux__
+        m_inotify_fd = inotify_init1(IN_NONBLOCK | IN_CLOEXEC);
+        m_wake_fd = eventfd(0, EFD_CLOEXEC);
+        if ((m_inotify_fd >= 0) && (m_wake_fd >= 0))
+        {
+            try
+            {
+                m_watcher = std::thread(&Implementation::watch, this);
+            }
+            catch (const std::system_error&)
+            {
+                // Without watcher, changes are detected by stat'ing the files
+            }
+        }
+        if (!m_watcher.joinable() && (m_inotify_fd >= 0))
+        {
+            ::close(m_inotify_fd);
+            m_inotify_fd = -1;
+        }
+#endif
+    }
+
+    //!------------------------------------------------------------------------
+    //! \brief Destructor. Stop the watcher thread.
+    //!------------------------------------------------------------------------
+    ~Implementation()
+    {
+        // Libraries still referenced elsewhere keep publishing into m_events
+        m_events->close();
+        // and load on their own threads
+        m_loader->stop();
+#ifdef __linux__
+        if (m_watcher.joinable())
+        {
+            std::uint64_t value = 1u;
+            ssize_t written;
+            do
+            {
+                written = ::write(m_wake_fd, &value, sizeof(value));
+            } while ((written < 0) && (errno == EINTR));
+            m_watcher.join();
+        }
+        if (m_wake_fd >= 0)
+        {
+            ::close(m_wake_fd);
+        }
+        if (m_inotify_fd >= 0)
+        {
+            ::close(m_inotify_fd);
+        }
+#endif
+    }
+
+    //!------------------------------------------------------------------------
+    //! \brief Entry of the persistent plugin index
+    //!------------------------------------------------------------------------
+    struct IndexedPlugin
+    {
+        FileSignature signature;
+        bool has_metadata = false;
+        PluginMetadata metadata;
+    };
+
+    //!------------------------------------------------------------------------
+    //! \brief Read a plugin index written by savePluginIndex()
+    //! \return The entries by file name; none if the index is missing,
+    //!   unreadable or describes another directory
+    //!------------------------------------------------------------------------
+    static std::unordered_map<std::string, IndexedPlugin>
+    loadPluginIndex(const std::string& p_path, const std::string& p_directory)
+    {
+        std::unordered_map<std::string, IndexedPlugin> index;
+        std::ifstream file(p_path);
+        std::string line;
+        if (!std::getline(file, line) ||
+            (line != "DLPLUGINDEX1\t" + p_directory))
+        {
+            return index;
+        }
+
+        auto split = [](const std::string& p_line, char p_separator)
+        {
+            std::vector<std::string> fields;
+            std::size_t begin = 0u;
+            for (;;)
+            {
+                std::size_t end = p_line.find(p_separator, begin);
+                fields.push_back(p_line.substr(begin, end - begin));
+                if (end == std::string::npos)
+                {
+                    return fields;
+                }
+                begin = end + 1u;
+            }
+        };
+        auto list = [&split](const std::string& p_field)
+        {
+            return p_field.empty() ? std::vector<std::string>()
+                                   : split(p_field, ',');
+        };
+
+        while (std::getline(file, line))
+        {
+            // file, mtime, size, inode, device, has note, name, version,
+            // capabilities, required symbols
+            auto fields = split(line, '\t');
+            if (fields.size() != 10u)
+            {
+                return {};
+            }
+
+            IndexedPlugin plugin;
+            try
+            {
+                plugin.signature.mtime_ns = std::stoll(fields[1]);
+                plugin.signature.size = std::stoull(fields[2]);
+                plugin.signature.inode = std::stoull(fields[3]);
+                plugin.signature.device = std::stoull(fields[4]);
+            }
+            catch (const std::exception&)
+            {
+                return {};
+            }
+            plugin.has_metadata = (fields[5] == "1");
+            plugin.metadata.name = fields[6];
+            plugin.metadata.version = fields[7];
+            plugin.metadata.capabilities = list(fields[8]);
+            plugin.metadata.required_symbols = list(fields[9]);
+            index.emplace(fields[0], std::move(plugin));
+        }
+        return index;
+    }
+
+    //!------------------------------------------------------------------------
+    //! \brief Write the plugin index of a directory. The file is replaced
+    //! atomically. Files whose name or metadata hold a separator are left out
+    //! and thus read again at the next scan.
+    //!------------------------------------------------------------------------
+    static void savePluginIndex(const std::string& p_path,
+                                const std::string& p_directory,
+                                const std::vector<std::string>& p_files,
+                                const std::vector<IndexedPlugin>& p_plugins)
+    {
+        auto valid = [](const std::string& p_field)
+        { return p_field.find_first_of("\t\n") == std::string::npos; };
+        auto join = [](const std::vector<std::string>& p_list)
+        {
+            std::string joined;
+            for (const auto& item : p_list)
+            {
+                joined += (joined.empty() ? "" : ",") + item;
+            }
+            return joined;
+        };
+
+        std::string tmp_path = temporaryPath(p_path);
+        {
+            std::ofstream file(tmp_path, std::ios::trunc);
+            file << "DLPLUGINDEX1\t" << p_directory << '\n';
+            for (std::size_t i = 0u; i < p_files.size(); ++i)
+            {
+                const IndexedPlugin& plugin = p_plugins[i];
+                const PluginMetadata& metadata = plugin.metadata;
+                std::string capabilities = join(metadata.capabilities);
+                std::string required = join(metadata.required_symbols);
+                if ((plugin.signature.size == 0u) || !valid(p_files[i]) ||
+                    !valid(metadata.name) || !valid(metadata.version) ||
+                    !valid(capabilities) || !valid(required))
+                {
+                    continue;
+                }
+                file << p_files[i] << '\t' << plugin.signature.mtime_ns
+                     << '\t' << plugin.signature.size << '\t'
+                     << plugin.signature.inode << '\t'
+                     << plugin.signature.device << '\t'
+                     << (plugin.has_metadata ? 1 : 0) << '\t' << metadata.name
+                     << '\t' << metadata.version << '\t' << capabilities
+                     << '\t' << required << '\n';
+            }
+            if (!file.good())
+            {
+                std::remove(tmp_path.c_str());
+                return;
+            }
+        }
+        std::rename(tmp_path.c_str(), p_path.c_str());
+    }
+
+    //!------------------------------------------------------------------------
+    //! \brief Add the symbols of a library to the symbol index
+    //!------------------------------------------------------------------------
+    void addProvider(const std::string& p_name,
+                     const std::shared_ptr<DynamicLibrary>& p_library,
+                     const std::vector<std::string>& p_symbols)
+    {
+        auto priority = m_priorities.find(p_name);
+        SymbolProvider provider{
+            (priority != m_priorities.end()) ? priority->second : 0,
+            p_name,
+            p_library
+        };
+
+        for (const auto& symbol : p_symbols)
+        {
+            auto& providers = m_symbols[symbol];
+            auto position = std::find_if(
+                providers.begin(),
+                providers.end(),
+                [&provider](const SymbolProvider& p_other)
+                {
+                    return (p_other.priority < provider.priority) ||
+                           ((p_other.priority == provider.priority) &&
+                            (p_other.name > provider.name));
+                });
+            providers.insert(position, provider);
+        }
+    }
+
+    //!------------------------------------------------------------------------
+    //! \brief Remove the symbols of a library from the symbol index
+    //!------------------------------------------------------------------------
+    void removeProvider(const std::string& p_name,
+                        const std::vector<std::string>& p_symbols)
+    {
+        for (const auto& symbol : p_symbols)
+        {
+            auto it = m_symbols.find(symbol);
+            if (it == m_symbols.end())
+            {
+                continue;
+            }
+            auto& providers = it->second;
+            providers.erase(
+                std::remove_if(providers.begin(),
+                               providers.end(),
+                               [&p_name](const SymbolProvider& p_provider)
+                               { return p_provider.name == p_name; }),
+                providers.end());
+            if (providers.empty())
+            {
+                m_symbols.erase(it);
+            }
+        }
+    }
+
+    //!------------------------------------------------------------------------
+    //! \brief Bring the symbol index up to date: only the libraries loaded,
+    //! reloaded or unloaded since the last refresh are read again. A library
+    //! which is not loaded (registered lazily or evicted) keeps the symbols
+    //! it had when last loaded, since using them loads it back.
+    //! \note m_symbols_mutex must be held exclusively.
+    //!------------------------------------------------------------------------
+    void refreshSymbols()
+    {
+        std::uint64_t generation = m_generation->load();
+        if (generation == m_symbols_generation)
+        {
+            return;
+        }
+
+        std::unordered_set<std::string> present;
+        for (const auto& library_pair : namedSnapshot())
+        {
+            const std::string& name = library_pair.first;
+            const auto& library = library_pair.second;
+            present.insert(name);
+
+            auto& indexed = m_indexed_libraries[name];
+            std::uint64_t load_generation =
+                library->m_impl->load_generation.load();
+            if ((indexed.library == library) &&
+                (indexed.generation == load_generation))
+            {
+                continue;
+            }
+
+            std::vector<std::string> symbols;
+            bool loaded;
+            {
+                std::lock_guard<std::mutex> lock(library->m_impl->mutex);
+                loaded = (library->m_impl->lib.handle != nullptr);
+                symbols = library->m_impl->exportedSymbols();
+            }
+            if (loaded || (indexed.library != library))
+            {
+                removeProvider(name, indexed.symbols);
+                addProvider(name, library, symbols);
+                indexed.symbols = std::move(symbols);
+            }
+            indexed.library = library;
+            indexed.generation = load_generation;
+        }
+
+        for (auto it = m_indexed_libraries.begin();
+             it != m_indexed_libraries.end();)
+        {
+            if (present.count(it->first) == 0u)
+            {
+                removeProvider(it->first, it->second.symbols);
+                it = m_indexed_libraries.erase(it);
+            }
+            else
+            {
+                ++it;
+            }
+        }
+        m_symbols_generation = generation;
+    }
+
+    //!------------------------------------------------------------------------
+    //! \brief Remove a library from the symbol index at once, so that the
+    //! index does not keep it loaded.
+    //!------------------------------------------------------------------------
+    void unindexLibrary(const std::string& p_name)
+    {
+        std::unique_lock<std::shared_timed_mutex> lock(m_symbols_mutex);
+        auto it = m_indexed_libraries.find(p_name);
+        if (it != m_indexed_libraries.end())
+        {
+            removeProvider(p_name, it->second.symbols);
+            m_indexed_libraries.erase(it);
+        }
+    }
+
+    //!------------------------------------------------------------------------
+    //! \brief Pool of the manager, started at the first parallel loop. The
+    //! calling thread takes part in the loops, hence one worker less than
+    //! the hardware threads.
+    //!------------------------------------------------------------------------
+    WorkStealingPool& pool()
+    {
+        std::call_once(m_pool_once,
+                       [this]()
+                       {
+                           unsigned threads =
+                               std::thread::hardware_concurrency();
+                           m_pool.reset(new WorkStealingPool(
+                               std::max(2u, threads) - 1u));
+                       });
+        return *m_pool;
+    }
+
+    //!------------------------------------------------------------------------
+    //! \brief Call p_function(i) for i in [0, p_count) on the pool. Small
+    //! counts run on the calling thread only, as handing them off would cost
+    //! more than the work itself.
+    //!------------------------------------------------------------------------
+    void parallelFor(std::size_t p_count,
+                     const std::function<void(std::size_t)>& p_function)
+    {
+        constexpr std::size_t MIN_BATCH = 32u;
+
+        if (p_count < 2u * MIN_BATCH)
+        {
+            for (std::size_t i = 0u; i < p_count; ++i)
+            {
+                p_function(i);
+            }
+            return;
+        }
+        pool().run(p_count, p_function);
+    }
+
+    //!------------------------------------------------------------------------
+    //! \brief Look a library up without lock
+    //! \return The library, or nullptr if the name is unknown
+    //!------------------------------------------------------------------------
+    std::shared_ptr<DynamicLibrary> find(const std::string& p_name) const
+    {
+        LibraryHandle handle;
+        return find(p_name, handle);
+    }
+
+    //!------------------------------------------------------------------------
+    //! \brief Same as find(), also giving the handle of the library
+    //! \param p_handle Receives the handle, invalid if the name is unknown
+    //!------------------------------------------------------------------------
+    std::shared_ptr<DynamicLibrary> find(const std::string& p_name,
+                                         LibraryHandle& p_handle) const
+    {
+        p_handle = m_libraries.read([&p_name](const Libraries& p_libraries)
+                                    { return p_libraries.handle(p_name); });
+        return get(p_handle);
+    }
+
+    //!------------------------------------------------------------------------
+    //! \brief Look a library up by its handle without lock. A library being
+    //! evicted is waited for: it is only given out once the eviction, which
+    //! checks that nobody holds it, is done.
+    //! \return The library, or nullptr if the handle is stale
+    //!------------------------------------------------------------------------
+    std::shared_ptr<DynamicLibrary> get(LibraryHandle p_handle) const
+    {
+        bool retired = false;
+        auto library = m_libraries.read(
+            [&](const Libraries& p_libraries)
+            {
+                retired = p_libraries.retired(p_handle);
+                return p_libraries.get(p_handle);
+            });
+        if (retired)
+        {
+            std::lock_guard<std::mutex> lock(m_mutex);
+            library = m_libraries.get().get(p_handle);
+        }
+        return library;
+    }
+
+    //!------------------------------------------------------------------------
+    //! \brief References on all the managed libraries, so that they can be
+    //! iterated without holding any lock.
+    //!------------------------------------------------------------------------
+    std::vector<std::shared_ptr<DynamicLibrary>> snapshot() const
+    {
+        return m_libraries.read(
+            [](const Libraries& p_libraries)
+            {
+                std::vector<std::shared_ptr<DynamicLibrary>> libraries;
+                libraries.reserve(p_libraries.names.size());
+                for (const auto& slot : p_libraries.slots)
+                {
+                    if (slot.library)
+                    {
+                        libraries.push_back(slot.library);
+                    }
+                }
+                return libraries;
+            });
+    }
+
+    //!------------------------------------------------------------------------
+    //! \brief Same as snapshot(), with the names of the libraries
+    //!------------------------------------------------------------------------
+    std::vector<std::pair<std::string, std::shared_ptr<DynamicLibrary>>>
+    namedSnapshot() const
+    {
+        return m_libraries.read(
+            [](const Libraries& p_libraries)
+            {
+                std::vector<
+                    std::pair<std::string, std::shared_ptr<DynamicLibrary>>>
+                    libraries;
+                libraries.reserve(p_libraries.names.size());
+                for (const auto& name : p_libraries.names)
+                {
+                    // Skip the library being evicted, if any
+                    if (const auto& library =
+                            p_libraries.slots[name.second].library)
+                    {
+                        libraries.emplace_back(name.first, library);
+                    }
+                }
+                return libraries;
+            });
+    }
+
+    //!------------------------------------------------------------------------
+    //! \brief Short names under which a file can be referred to. For
+    //! "libfoo.so": "libfoo.so", "libfoo" and "foo".
+    //!------------------------------------------------------------------------
+    static std::vector<std::string> shortNames(const std::string& p_file)
+    {
+        std::vector<std::string> names = { p_file };
+        const std::string extension(LIB_EXTENSION);
+        if ((p_file.size() > extension.size()) &&
+            (p_file.compare(p_file.size() - extension.size(),
+                            extension.size(),
+                            extension) == 0))
+        {
+            std::string stem =
+                p_file.substr(0, p_file.size() - extension.size());
+            if ((stem.size() > 3u) && (stem.compare(0, 3, "lib") == 0))
+            {
+                names.push_back(stem.substr(3));
+            }
+            names.push_back(std::move(stem));
+        }
+        return names;
+    }
+
+    //!------------------------------------------------------------------------
+    //! \brief Update the cache entry of a short name from the file lists of
+    //! the search directories. No file system access is made.
+    //!------------------------------------------------------------------------
+    void refreshName(const std::string& p_name)
+    {
+        const std::string candidates[] = { p_name,
+                                           "lib" + p_name + LIB_EXTENSION,
+                                           p_name + LIB_EXTENSION };
+        for (const auto& directory : m_search_directories)
+        {
+            for (const auto& candidate : candidates)
+            {
+                if (directory.files.count(candidate) != 0u)
+                {
+                    m_resolved[p_name] = directory.path + "/" + candidate;
+                    return;
+                }
+            }
+        }
+        m_resolved.erase(p_name);
+    }
+
+    //!------------------------------------------------------------------------
+    //! \brief Record that a file appeared in or disappeared from a directory
+    //!------------------------------------------------------------------------
+    void updateFile(SearchDirectory& p_directory,
+                    const std::string& p_file,
+                    bool p_exists)
+    {
+        if (p_exists)
+        {
+            p_directory.files.insert(p_file);
+        }
+        else
+        {
+            p_directory.files.erase(p_file);
+        }
+
+        for (const auto& name : shortNames(p_file))
+        {
+            refreshName(name);
+        }
+    }
+
+    //!------------------------------------------------------------------------
+    //! \brief List the files of a search directory
+    //!------------------------------------------------------------------------
+    void scanDirectory(SearchDirectory& p_directory)
+    {
+        std::vector<std::string> previous(p_directory.files.begin(),
+                                          p_directory.files.end());
+        p_directory.files.clear();
+        for (const auto& file : previous)
+        {
+            updateFile(p_directory, file, false);
+        }
+
+#ifndef _WIN32
+        DIR* dir = opendir(p_directory.path.c_str());
+        if (!dir)
+        {
+            return;
+        }
+        while (struct dirent* entry = readdir(dir))
+        {
+            if (entry->d_name[0] != '.')
+            {
+                updateFile(p_directory, entry->d_name, true);
+            }
+        }
+        closedir(dir);
+#endif
+    }
+
+    //!------------------------------------------------------------------------
+    //! \brief Watch a search directory again at its path and list it. The
+    //! previous watch is removed when it follows a directory moved away.
+    //! Without watch (missing directory), another attempt is made by
+    //! processDirectoryEvents() after WATCH_RETRY.
+    //!------------------------------------------------------------------------
+    void rearmDirectory(SearchDirectory& p_directory)
+    {
+        int previous = p_directory.watch;
+        p_directory.watch = addWatch(p_directory.path);
+        if (previous != p_directory.watch)
+        {
+            removeWatch(previous);
+
+            // Before the scan, which covers the events dropped meanwhile
+            m_search_watches.update(
+                [this](std::vector<int>& p_watches)
+                {
+                    p_watches.clear();
+                    for (const auto& directory : m_search_directories)
+                    {
+                        if (directory.watch >= 0)
+                        {
+                            p_watches.push_back(directory.watch);
+                        }
+                    }
+                });
+        }
+        if (p_directory.watch < 0)
+        {
+            p_directory.retry = std::chrono::steady_clock::now() + WATCH_RETRY;
+        }
+        scanDirectory(p_directory);
+    }
+
+    //!------------------------------------------------------------------------
+    //! \brief Check if a watch descriptor is used by a search directory or a
+    //! managed library
+    //!------------------------------------------------------------------------
+    bool isWatchUsed(int p_watch) const
+    {
+        for (const auto& directory : m_search_directories)
+        {
+            if (directory.watch == p_watch)
+            {
+                return true;
+            }
+        }
+        for (const auto& library : m_library_watches)
+        {
+            for (const auto& entry : library.second)
+            {
+                if (entry.first == p_watch)
+                {
+                    return true;
+                }
+            }
+        }
+        return false;
+    }
+
+    //!------------------------------------------------------------------------
+    //! \brief Watch a directory
+    //! \return The watch descriptor, or -1 if it cannot be watched
+    //!------------------------------------------------------------------------
+    int addWatch(const std::string& p_directory)
+    {
+#ifdef __linux__
+        if (m_inotify_fd >= 0)
+        {
+            return inotify_add_watch(
+                m_inotify_fd, p_directory.c_str(), WATCH_MASK);
+        }
+#endif
+        (void) p_directory;
+        return -1;
+    }
+
+    //!------------------------------------------------------------------------
+    //! \brief Body of the watcher thread: wait for inotify events until the
+    //! wake descriptor is signaled.
+    //!------------------------------------------------------------------------
+    void watch()
+    {
+#ifdef __linux__
+        struct pollfd fds[2] = { { m_inotify_fd, POLLIN, 0 },
+                                 { m_wake_fd, POLLIN, 0 } };
+        for (;;)
+        {
+            if (::poll(fds, 2, -1) < 0)
+            {
+                if (errno == EINTR)
+                {
+                    continue;
+                }
+                return;
+            }
+            if (fds[1].revents != 0)
+            {
+                return;
+            }
+            readEvents();
+        }
+#endif
+    }
+
+    //!------------------------------------------------------------------------
+    //! \brief Read and dispatch the pending inotify events, without blocking.
+    //! Readers are serialized so that events are queued in order.
+    //!------------------------------------------------------------------------
+    void readEvents()
+    {
+#ifdef __linux__
+        std::lock_guard<std::mutex> lock(m_read_mutex);
+
+        alignas(struct inotify_event) char buffer[4096];
+        ssize_t length;
+        while ((length = ::read(m_inotify_fd, buffer, sizeof(buffer))) > 0)
+        {
+            for (char* ptr = buffer; ptr < buffer + length;)
+            {
+                auto* event = reinterpret_cast<struct inotify_event*>(ptr);
+                ptr += sizeof(struct inotify_event) + event->len;
+                dispatch(*event);
+            }
+        }
+#endif
+    }
+
+#ifdef __linux__
+    //!------------------------------------------------------------------------
+    //! \brief Forward an inotify event: changes of the file lists of the
+    //! search directories are queued for the search path cache, and the
+    //! libraries whose file may have changed are flagged.
+    //!------------------------------------------------------------------------
+    void dispatch(const struct inotify_event& p_event)
+    {
+        if ((p_event.mask & LISTING_MASK) &&
+            ((p_event.mask & IN_Q_OVERFLOW) ||
+             m_search_watches.read(
+                 [&p_event](const std::vector<int>& p_watches)
+                 {
+                     return std::find(p_watches.begin(),
+                                      p_watches.end(),
+                                      p_event.wd) != p_watches.end();
+                 })))
+        {
+            // Not applied until the next resolve(): once full, the whole
+            // cache is rebuilt instead
+            if (!m_directory_events.push(
+                    { p_event.wd,
+                      p_event.mask,
+                      (p_event.len > 0u) ? p_event.name : "" }))
+            {
+                m_directory_overflow.store(true, std::memory_order_release);
+            }
+        }
+
+        using FileWatch = DynamicLibrary::Implementation::FileWatch;
+        // The directory is no longer watched at its path
+        const bool lost =
+            (p_event.mask & (IN_DELETE_SELF | IN_MOVE_SELF | IN_IGNORED)) != 0;
+
+        auto libraries = m_watched.read(
+            [&p_event, lost](const WatchedDirectories& p_directories)
+            {
+                std::vector<std::pair<std::shared_ptr<DynamicLibrary>,
+                                      FileWatch>>
+                    found;
+                auto collect =
+                    [&found, lost](const WatchedFiles::mapped_type& p_l)
+                {
+                    for (const auto& library : p_l)
+                    {
+                        if (auto locked = library.library.lock())
+                        {
+                            // A link may now lead to an unwatched file
+                            found.emplace_back(std::move(locked),
+                                               (lost || library.link)
+                                                   ? FileWatch::None
+                                                   : FileWatch::Changed);
+                        }
+                    }
+                };
+
+                for (const auto& directory : p_directories)
+                {
+                    if ((directory.first != p_event.wd) &&
+                        !(p_event.mask & IN_Q_OVERFLOW))
+                    {
+                        continue;
+                    }
+                    if ((p_event.len > 0u) &&
+                        !(p_event.mask & IN_Q_OVERFLOW))
+                    {
+                        auto file = directory.second->find(p_event.name);
+                        if (file != directory.second->end())
+                        {
+                            collect(file->second);
+                        }
+                        continue;
+                    }
+                    for (const auto& file : *directory.second)
+                    {
+                        collect(file.second);
+                    }
+                }
+                return found;
+            });
+
+        for (const auto& library : libraries)
+        {
+            auto& file_watch = library.first->m_impl->file_watch;
+            if (library.second == FileWatch::None)
+            {
+                file_watch.store(FileWatch::None);
+                continue;
+            }
+            // A library no longer watched (e.g. loaded again from another
+            // path) stays checked with stat
+            FileWatch clean = FileWatch::Clean;
+            file_watch.compare_exchange_strong(clean, FileWatch::Changed);
+        }
+    }
+#endif
+
+    //!------------------------------------------------------------------------
+    //! \brief Make a new library report its events to the subscribers of the
+    //! manager and use its loader thread. To be called before the library is
+    //! shared.
+    //!------------------------------------------------------------------------
+    void attach(const std::string& p_name, DynamicLibrary& p_library)
+    {
+        p_library.m_impl->manager_events = m_events;
+        p_library.m_impl->managed_name = p_name;
+        p_library.m_impl->loader = m_loader;
+        p_library.m_impl->manager_generation = m_generation;
+        p_library.setMetricsRecording(m_metrics_recording);
+    }
+
+    //!------------------------------------------------------------------------
+    //! \brief Wait until no library is being loaded under a name. m_mutex is
+    //! released while waiting.
+    //!------------------------------------------------------------------------
+    void waitLoading(std::unique_lock<std::mutex>& p_lock,
+                     const std::string& p_name)
+    {
+        m_loaded.wait(p_lock,
+                      [this, &p_name]()
+                      { return m_loading.count(p_name) == 0u; });
+    }
+
+    //! ***********************************************************************
+    //! \brief Names reserved while their libraries are loaded with m_mutex
+    //! released, so that the loads do not wait for each other nor hold the
+    //! manager while the loader thread runs the constructors of a library.
+    //! The other modifications of these names wait (see waitLoading()) until
+    //! the loads are published, or given up when the reservation is
+    //! destroyed.
+    //! ***********************************************************************
+    class Reservation
+    {
+    public:
+
+        //! \param p_lock Lock held on m_mutex
+        Reservation(Implementation& p_manager,
+                    std::unique_lock<std::mutex>& p_lock)
+            : m_manager(p_manager), m_lock(p_lock)
+        {
+        }
+
+        Reservation(const Reservation&) = delete;
+        Reservation& operator=(const Reservation&) = delete;
+
+        ~Reservation()
+        {
+            if (m_names.empty())
+            {
+                return;
+            }
+            if (!m_lock.owns_lock())
+            {
+                m_lock.lock();
+            }
+            release();
+        }
+
+        //! \brief Reserve a name, with m_mutex held
+        void add(const std::string& p_name)
+        {
+            m_manager.m_loading.insert(p_name);
+            m_names.push_back(p_name);
+        }
+
+        //! \brief Free the names, with m_mutex held
+        void release()
+        {
+            for (const auto& name : m_names)
+            {
+                m_manager.m_loading.erase(name);
+            }
+            if (!m_names.empty())
+            {
+                m_names.clear();
+                m_manager.m_loaded.notify_all();
+            }
+        }
+
+    private:
+
+        Implementation& m_manager;
+        std::unique_lock<std::mutex>& m_lock;
+        std::vector<std::string> m_names;
+    };
+
+    //!------------------------------------------------------------------------
+    //! \brief Files to watch for a library: its path, then the target of each
+    //! symbolic link met on the way to the actual file, so that rebuilding
+    //! the target and changing the link are both seen.
+    //! \return The directory and the name of each file
+    //!------------------------------------------------------------------------
+    static std::vector<std::pair<std::string, std::string>>
+    watchedFiles(const std::string& p_path)
+    {
+        std::vector<std::pair<std::string, std::string>> files;
+        std::string path = p_path;
+        // Same limit as the kernel for nested links
+        for (int hops = 0; hops < 40; ++hops)
+        {
+            std::size_t slash = path.find_last_of('/');
+            std::string directory = ".";
+            if (slash != std::string::npos)
+            {
+                directory = (slash == 0u) ? "/" : path.substr(0, slash);
+            }
+            files.emplace_back(directory, path.substr(slash + 1u));
+
+#ifndef _WIN32
+            struct stat link_stat;
+            if ((lstat(path.c_str(), &link_stat) != 0) ||
+                !S_ISLNK(link_stat.st_mode))
+            {
+                break;
+            }
+            char target[4096];
+            ssize_t length = readlink(path.c_str(), target, sizeof(target));
+            if ((length <= 0) || (std::size_t(length) == sizeof(target)))
+            {
+                break;
+            }
+            path.assign(target, std::size_t(length));
+            if ((path[0] != '/') && (slash != std::string::npos))
+            {
+                path = directory + "/" + path;
+            }
+#else
+            break;
+#endif
+        }
+        return files;
+    }
+
+    //!------------------------------------------------------------------------
+    //! \brief Let the watcher thread notify a library of the changes of its
+    //! file, so that checking it for updates no longer needs a stat.
+    //!------------------------------------------------------------------------
+    void watchLibrary(const std::string& p_name,
+                      const std::shared_ptr<DynamicLibrary>& p_library)
+    {
+        if (!m_watcher.joinable())
+        {
+            return;
+        }
+
+        std::string path;
+        {
+            std::lock_guard<std::mutex> lock(p_library->m_impl->mutex);
+            if (p_library->m_impl->lib.in_memory)
+            {
+                return;
+            }
+            path = p_library->m_impl->lib.path;
+        }
+
+        std::vector<std::pair<int, std::string>> watches;
+        for (const auto& file : watchedFiles(path))
+        {
+            int watch = addWatch(file.first);
+            if (watch < 0)
+            {
+                // Partially watched: keep checking the file with stat
+                for (const auto& added : watches)
+                {
+                    removeWatch(added.first);
+                }
+                return;
+            }
+            watches.emplace_back(watch, file.second);
+        }
+
+        // Changes made before the watch was added are caught by one stat
+        p_library->m_impl->file_watch.store(
+            DynamicLibrary::Implementation::FileWatch::Changed);
+
+        std::weak_ptr<DynamicLibrary> library(p_library);
+        m_watched.update(
+            [&](WatchedDirectories& p_directories)
+            {
+                for (std::size_t i = 0u; i < watches.size(); ++i)
+                {
+                    auto& files = p_directories[watches[i].first];
+                    auto copy = files ? std::make_shared<WatchedFiles>(*files)
+                                      : std::make_shared<WatchedFiles>();
+                    (*copy)[watches[i].second].push_back(
+                        { p_name, library, i + 1u < watches.size() });
+                    files = std::move(copy);
+                }
+            });
+        m_library_watches[p_name] = std::move(watches);
+    }
+
+    //!------------------------------------------------------------------------
+    //! \brief Stop notifying a library. It checks its file with stat again.
+    //!------------------------------------------------------------------------
+    void unwatchLibrary(const std::string& p_name,
+                        const std::shared_ptr<DynamicLibrary>& p_library)
+    {
+        auto it = m_library_watches.find(p_name);
+        if (it == m_library_watches.end())
+        {
+            return;
+        }
+
+        auto watches = std::move(it->second);
+        m_library_watches.erase(it);
+        m_watched.update(
+            [&](WatchedDirectories& p_directories)
+            {
+                for (const auto& watch : watches)
+                {
+                    unwatchFile(p_directories, p_name, watch);
+                }
+            });
+
+        if (p_library)
+        {
+            p_library->m_impl->file_watch.store(
+                DynamicLibrary::Implementation::FileWatch::None);
+        }
+
+        // The directories no longer used by anything are not watched
+        for (const auto& watch : watches)
+        {
+            removeWatch(watch.first);
+        }
+    }
+
+    //!------------------------------------------------------------------------
+    //! \brief Remove a library from the libraries of a watched file
+    //!------------------------------------------------------------------------
+    static void unwatchFile(WatchedDirectories& p_directories,
+                            const std::string& p_name,
+                            const std::pair<int, std::string>& p_watch)
+    {
+        auto directory = p_directories.find(p_watch.first);
+        if (directory == p_directories.end())
+        {
+            return;
+        }
+        auto copy = std::make_shared<WatchedFiles>(*directory->second);
+        auto file = copy->find(p_watch.second);
+        if (file != copy->end())
+        {
+            auto& libraries = file->second;
+            libraries.erase(
+                std::remove_if(libraries.begin(),
+                               libraries.end(),
+                               [&p_name](const WatchedLibrary& p_library)
+                               { return p_library.name == p_name; }),
+                libraries.end());
+            if (libraries.empty())
+            {
+                copy->erase(file);
+            }
+        }
+        if (copy->empty())
+        {
+            p_directories.erase(directory);
+        }
+        else
+        {
+            directory->second = std::move(copy);
+        }
+    }
+
+    //!------------------------------------------------------------------------
+    //! \brief Remove a watch which no search directory nor library uses
+    //!------------------------------------------------------------------------
+    void removeWatch(int p_watch)
+    {
+#ifdef __linux__
+        if ((p_watch >= 0) && !isWatchUsed(p_watch))
+        {
+            inotify_rm_watch(m_inotify_fd, p_watch);
+        }
+#else
+        (void) p_watch;
+#endif
+    }
+
+    //!------------------------------------------------------------------------
+    //! \brief Apply the queued directory changes to the cache of resolved
+    //! names. The events not yet read by the watcher thread are read here, so
+    //! that a file created just before is found. Without pending event this
+    //! costs a single read().
+    //!------------------------------------------------------------------------
+    void processDirectoryEvents()
+    {
+#ifdef __linux__
+        if (m_inotify_fd < 0)
+        {
+            return;
+        }
+        readEvents();
+
+        // Directories missing when added, or deleted since
+        auto now = std::chrono::steady_clock::now();
+        for (auto& directory : m_search_directories)
+        {
+            if ((directory.watch < 0) && (now >= directory.retry))
+            {
+                rearmDirectory(directory);
+            }
+        }
+
+        // Events were lost: the whole cache is rebuilt after the queue
+        bool rescan = m_directory_overflow.exchange(false);
+        DirectoryEvent event;
+        while (m_directory_events.pop(event))
+        {
+            if (event.mask & IN_Q_OVERFLOW)
+            {
+                rescan = true;
+            }
+            if (rescan)
+            {
+                continue;
+            }
+
+            for (auto& directory : m_search_directories)
+            {
+                if (directory.watch != event.watch)
+                {
+                    continue;
+                }
+                if (event.mask & (IN_DELETE_SELF | IN_MOVE_SELF | IN_IGNORED))
+                {
+                    // The watch is dead or follows the directory elsewhere
+                    rearmDirectory(directory);
+                }
+                else if (!event.file.empty())
+                {
+                    updateFile(directory,
+                               event.file,
+                               (event.mask & (IN_CREATE | IN_MOVED_TO)) != 0u);
+                }
+            }
+        }
+
+        if (rescan)
+        {
+            // Watched again too: the loss of a watch may have been dropped
+            for (auto& directory : m_search_directories)
+            {
+                rearmDirectory(directory);
+            }
+        }
+#endif
+    }
+
+    //!------------------------------------------------------------------------
+    //! \brief Resolve a short library name through the search directories
+    //! \return The path of the library, or an empty string if not found
+    //!------------------------------------------------------------------------
+    std::string resolve(const std::string& p_name)
+    {
+        processDirectoryEvents();
+        auto it = m_resolved.find(p_name);
+        return (it != m_resolved.end()) ? it->second : std::string();
+    }
+
+    //!------------------------------------------------------------------------
+    //! \brief Path of the library to load: short names (without directory)
+    //! are looked up in the search directories.
+    //!------------------------------------------------------------------------
+    std::string resolvePath(const std::string& p_path)
+    {
+        if (p_path.find_first_of("/\\") == std::string::npos)
+        {
+            std::string resolved = resolve(p_path);
+            if (!resolved.empty())
+            {
+                return resolved;
+            }
+        }
+        return p_path;
+    }
+
+    //!------------------------------------------------------------------------
+    //! \brief Count the references to a library held by the manager itself:
+    //! its slot, the symbol index and the functions cached by resolveAll()
+    //! which no invokeAll() is using.
+    //!------------------------------------------------------------------------
+    long managerReferences(const std::string& p_name,
+                           const DynamicLibrary* p_library)
+    {
+        long references = 1;
+        {
+            std::shared_lock<std::shared_timed_mutex> lock(m_symbols_mutex);
+            auto it = m_indexed_libraries.find(p_name);
+            if ((it != m_indexed_libraries.end()) &&
+                (it->second.library.get() == p_library))
+            {
+                // The entry itself and one provider per symbol
+                references += 1 + static_cast<long>(it->second.symbols.size());
+            }
+        }
+
+        std::lock_guard<std::mutex> lock(m_functions_mutex);
+        for (const auto& function : m_functions)
+        {
+            if (!function.second.targets ||
+                (function.second.targets.use_count() > 1))
+            {
+                continue;
+            }
+            for (const auto& target : *function.second.targets)
+            {
+                if (target.owner.get() == p_library)
+                {
+                    ++references;
+                }
+            }
+        }
+        return references;
+    }
+
+    //!------------------------------------------------------------------------
+    //! \brief Evict the least recently used libraries until the loaded ones
+    //! fit in the memory budget. A library is kept while it is shared outside
+    //! of the manager, or used within the minimum idle time.
+    //! \param p_loading Library loaded by the calling operation, never
+    //!   evicted (nullptr: none)
+    //! \return Number of evicted libraries
+    //!------------------------------------------------------------------------
+    std::size_t enforceMemoryBudget(const DynamicLibrary* p_loading = nullptr)
+    {
+        if (m_memory_budget == 0u)
+        {
+            return 0u;
+        }
+
+        // By slot and name: evicting replaces the value of m_libraries
+        struct Candidate
+        {
+            std::size_t index;
+            std::string name;
+            std::chrono::steady_clock::time_point last_use;
+            std::size_t size;
+        };
+
+        const Libraries& libraries = m_libraries.get();
+        std::vector<const std::string*> names(libraries.slots.size(), nullptr);
+        for (const auto& name : libraries.names)
+        {
+            names[name.second] = &name.first;
+        }
+
+        std::vector<Candidate> candidates;
+        std::size_t total = 0u;
+        for (std::size_t i = 0u; i < libraries.slots.size(); ++i)
+        {
+            const auto& library = libraries.slots[i].library;
+            if (!library || !library->isLoaded())
+            {
+                continue;
+            }
+            std::size_t size = library->getMappedSize();
+            total += size;
+            if (library.get() != p_loading)
+            {
+                candidates.push_back(
+                    { i, *names[i], library->getLastUse(), size });
+            }
+        }
+
+        if (total <= m_memory_budget)
+        {
+            return 0u;
+        }
+
+        std::sort(candidates.begin(),
+                  candidates.end(),
+                  [](const Candidate& p_a, const Candidate& p_b)
+                  { return p_a.last_use < p_b.last_use; });
+
+        auto now = std::chrono::steady_clock::now();
+        std::size_t evicted = 0u;
+        for (const auto& candidate : candidates)
+        {
+            if (total <= m_memory_budget)
+            {
+                break;
+            }
+            if (now - candidate.last_use < m_min_idle)
+            {
+                break; // The next ones have been used even more recently
+            }
+            // Callers may still hold the library or its functions
+            const auto& library =
+                m_libraries.get().slots[candidate.index].library;
+            if (library.use_count() >
+                managerReferences(candidate.name, library.get()))
+            {
+                continue;
+            }
+            if (evict(candidate.index, candidate.name))
+            {
+                total -= candidate.size;
+                ++evicted;
+            }
+        }
+        return evicted;
+    }
+
+    //!------------------------------------------------------------------------
+    //! \brief Evict a library nobody holds. Its slot is emptied first and
+    //! the lock-free readers waited for, so that nobody can take the library
+    //! after the last check of its references; the readers meeting the empty
+    //! slot wait for m_mutex (see get()). Called with m_mutex held.
+    //! \param p_index Slot of the library
+    //! \param p_name Name of the library
+    //! \return True if the library was evicted
+    //!------------------------------------------------------------------------
+    bool evict(std::size_t p_index, const std::string& p_name)
+    {
+        std::shared_ptr<DynamicLibrary> library;
+        m_libraries.update(
+            [&](Libraries& p_libraries)
+            { library.swap(p_libraries.slots[p_index].library); });
+
+        // The reference of the slot is now held by library
+        bool evicted = false;
+        if (library.use_count() <= managerReferences(p_name, library.get()))
+        {
+            auto& impl = *library->m_impl;
+            DynamicLibrary::Implementation::StatusLock library_lock(impl);
+            library_lock.deferEvents();
+            m_pending_events.push_back(library);
+            evicted = impl.evict();
+        }
+
+        m_libraries.update([&](Libraries& p_libraries)
+                           { p_libraries.slots[p_index].library = library; });
+        return evicted;
+    }
+
+    //!------------------------------------------------------------------------
+    //! \brief Release m_mutex, then schedule the events the libraries
+    //! published while it was held: the subscribers may call the manager.
+    //! \param p_lock Lock of m_mutex
+    //!------------------------------------------------------------------------
+    void scheduleEvents(std::unique_lock<std::mutex>& p_lock)
+    {
+        std::vector<std::shared_ptr<DynamicLibrary>> libraries;
+        libraries.swap(m_pending_events);
+        p_lock.unlock();
+        for (const auto& library : libraries)
+        {
+            library->m_impl->scheduleEvents();
+        }
+    }
+};
+
+constexpr std::chrono::seconds
+    DynamicLibraryManager::Implementation::WATCH_RETRY;
+
+//!----------------------------------------------------------------------------
+DynamicLibrary::DynamicLibrary() noexcept
+    : m_impl(std::make_unique<Implementation>())
+{
+}
+
+//!----------------------------------------------------------------------------
+DynamicLibrary::DynamicLibrary(const std::string& p_library_path,
+                               AutoReload p_auto_reload,
+                               LinkNamespace p_namespace)
+    : m_impl(std::make_unique<Implementation>())
+{
+    if (!load(p_library_path, p_auto_reload, p_namespace))
+    {
+        throw DynamicLibraryException(m_impl->error_message);
+    }
+}
+
+//!----------------------------------------------------------------------------
+DynamicLibrary::~DynamicLibrary() = default;
+
+//!----------------------------------------------------------------------------
+DynamicLibrary::DynamicLibrary(DynamicLibrary&& p_other) noexcept
+    : m_impl(std::move(p_other.m_impl))
+{
+}
+
+//!----------------------------------------------------------------------------
+DynamicLibrary& DynamicLibrary::operator=(DynamicLibrary&& p_other) noexcept
+{
+    if (this != &p_other)
+    {
+        m_impl = std::move(p_other.m_impl);
+    }
+    return *this;
+}
+
+//!----------------------------------------------------------------------------
+bool DynamicLibrary::load(const std::string& p_library_path,
+                          AutoReload p_auto_reload,
+                          LinkNamespace p_namespace)
+{
+    Implementation::StatusLock lock(*m_impl);
+
+    if (m_impl->lib.handle)
+    {
+        m_impl->unloadInternal(); // On ignore le résultat
+    }
+    m_impl->closeFile();
+    m_impl->lib.pending = false;
+    // A watch of a manager follows the previous path: check with stat
+    m_impl->file_watch.store(Implementation::FileWatch::None);
+
+    int fd = -1;
+    FileSignature signature;
+    if (!m_impl->openFile(p_library_path, fd, signature))
+    {
+        return false;
+    }
+
+    m_impl->lib.path = p_library_path;
+    m_impl->setFile(fd, signature);
+    m_impl->lib.link_namespace = p_namespace;
+    m_impl->auto_reload = p_auto_reload;
+
+    if (!m_impl->loadInternal())
+    {
+        m_impl->closeFile();
+        return false;
+    }
+    m_impl->last_use.store(std::chrono::steady_clock::now());
+    return true;
+}
+
+//!----------------------------------------------------------------------------
+bool DynamicLibrary::loadLazy(const std::string& p_library_path,
+                              AutoReload p_auto_reload,
+                              LinkNamespace p_namespace)
+{
+    Implementation::StatusLock lock(*m_impl);
+
+    if (m_impl->lib.handle)
+    {
+        m_impl->unloadInternal();
+    }
+    m_impl->closeFile();
+    m_impl->lib.pending = false;
+    // A watch of a manager follows the previous path: check with stat
+    m_impl->file_watch.store(Implementation::FileWatch::None);
+
+    if (p_library_path.empty())
+    {
+        m_impl->error_message = "Library path cannot be empty";
+        return false;
+    }
+
+    FileSignature signature = m_impl->getFileSignature(p_library_path);
+    if (signature == FileSignature())
+    {
+        m_impl->error_message =
+            "Library file does not exist or is not accessible: " +
+            p_library_path;
+        return false;
+    }
+
+    m_impl->lib.path = p_library_path;
+    m_impl->lib.signature = signature;
+    m_impl->lib.link_namespace = p_namespace;
+    m_impl->lib.pending = true;
+    m_impl->auto_reload = p_auto_reload;
+    return true;
+}
+
+//!----------------------------------------------------------------------------
+bool DynamicLibrary::loadFromMemory(const void* p_data,
+                                    std::size_t p_size,
+                                    const std::string& p_name,
+                                    LinkNamespace p_namespace)
+{
+    Implementation::StatusLock lock(*m_impl);
+
+    if (m_impl->lib.handle)
+    {
+        m_impl->unloadInternal();
+    }
+    m_impl->closeFile();
+    m_impl->lib.pending = false;
+    // A watch of a manager follows the previous path: check with stat
+    m_impl->file_watch.store(Implementation::FileWatch::None);
+
+    int fd = m_impl->createMemoryFile(p_data, p_size, p_name);
+    if (fd < 0)
+    {
+        return false;
+    }
+
+    m_impl->setMemoryFile(fd, p_name);
+    m_impl->lib.link_namespace = p_namespace;
+    m_impl->auto_reload = AutoReload::Disabled;
+
+    if (!m_impl->loadInternal())
+    {
+        m_impl->closeFile();
+        return false;
+    }
+    return true;
+}
+
+//!----------------------------------------------------------------------------
+bool DynamicLibrary::unload()
+{
+    Implementation::StatusLock lock(*m_impl);
+    if (m_impl->inOwnCall())
+    {
+        m_impl->error_message = "Library '" + m_impl->lib.path +
+                                "' cannot be unloaded by one of its functions";
+        return false;
+    }
+    bool success = m_impl->unloadInternal();
+    m_impl->closeFile();
+    m_impl->lib.pending = false;
+    return success;
+}
+
+//!----------------------------------------------------------------------------
+bool DynamicLibrary::evict()
+{
+    Implementation::StatusLock lock(*m_impl);
+    return m_impl->evict();
+}
+
+//!----------------------------------------------------------------------------
+bool DynamicLibrary::isLoaded() const
+{
+    return m_impl->loaded.load(std::memory_order_acquire);
+}
+
+//!----------------------------------------------------------------------------
+void* DynamicLibrary::getSymbolInternal(const std::string& p_symbol_name)
+{
+    Implementation::StatusLock lock(*m_impl);
+    bool modified = false;
+
+    if (!m_impl->lib.handle)
+    {
+        // First use of a lazily registered library. The mutex guarantees a
+        // single dlopen() when several threads race for the first symbol.
+        if (!m_impl->lib.pending)
+        {
+            m_impl->error_message = "Library not loaded";
+            return nullptr;
+        }
+        if (!m_impl->loadPending())
+        {
+            return nullptr;
+        }
+        modified = true;
+    }
+
+    // Never from one of its functions: reloaded by the next use instead
+    if ((m_impl->auto_reload == AutoReload::Enabled) &&
+        !m_impl->inOwnCall() && m_impl->needsReload())
+    {
+        if (!m_impl->reloadInternal())
+        {
+            return nullptr;
+        }
+        modified = true;
+    }
+
+    // The time of use also starts the measure of the lookup
+    const auto start = std::chrono::steady_clock::now();
+    m_impl->last_use.store(start, std::memory_order_relaxed);
+
+    auto it = m_impl->lib.symbol_cache.find(p_symbol_name);
+    if (it != m_impl->lib.symbol_cache.end())
+    {
+        // A hit changes nothing observable, unless needsReload() recorded
+        // a bit-identical rebuild
+        if (!modified &&
+            (m_impl->lib.signature == m_impl->status.get().signature))
+        {
+            lock.keepStatus();
+        }
+        if (m_impl->metrics.isEnabled())
+        {
+            m_impl->metrics.record(Operation::LookupHit,
+                                   std::chrono::steady_clock::now() - start);
+        }
+        return it->second;
+    }
+
+    void* symbol = m_impl->getSymbolInternal(p_symbol_name);
+    if (symbol)
+    {
+        m_impl->lib.symbol_cache[p_symbol_name] = symbol;
+        m_impl->lib.symbols_dirty = true;
+    }
+
+    if (m_impl->metrics.isEnabled())
+    {
+        m_impl->metrics.record(Operation::LookupMiss,
+                               std::chrono::steady_clock::now() - start);
+    }
+    return symbol;
+}
+
+//!----------------------------------------------------------------------------
+void* DynamicLibrary::findOptionalSymbol(const std::string& p_symbol_name)
+{
+    std::lock_guard<std::mutex> lock(m_impl->mutex);
+    if (!m_impl->lib.handle)
+    {
+        return nullptr;
+    }
+
+    auto it = m_impl->lib.symbol_cache.find(p_symbol_name);
+    if (it != m_impl->lib.symbol_cache.end())
+    {
+        return it->second;
+    }
+
+    void* symbol = m_impl->findSymbol(p_symbol_name);
+    if (symbol)
+    {
+        m_impl->lib.symbol_cache[p_symbol_name] = symbol;
+        m_impl->lib.symbols_dirty = true;
+    }
+    return symbol;
+}
+
+//!----------------------------------------------------------------------------
+bool DynamicLibrary::checkForUpdates() const
+{
+    return m_impl->observeUpdates();
+}
+
+//!----------------------------------------------------------------------------
+bool DynamicLibrary::reload()
+{
+    Implementation::StatusLock lock(*m_impl);
+    return m_impl->lib.handle && m_impl->reloadInternal();
+}
+
+//!----------------------------------------------------------------------------
+bool DynamicLibrary::reload(const void* p_data, std::size_t p_size)
+{
+    Implementation::StatusLock lock(*m_impl);
+
+    if (!m_impl->lib.handle)
+    {
+        m_impl->error_message = "Library not loaded";
+        return false;
+    }
+
+    if (!m_impl->canReload())
+    {
+        m_impl->error_message =
+            "Library cannot be reloaded - reload capability not supported";
+        return false;
+    }
+
+    // Create the new memory file first: on failure the current build stays.
+    std::string name = m_impl->lib.path;
+    int fd = m_impl->createMemoryFile(p_data, p_size, name);
+    if (fd < 0)
+    {
+        return false;
+    }
+
+    m_impl->publish(LibraryEvent::PreReload);
+    m_impl->unloadInternal(false);
+    m_impl->closeFile();
+    m_impl->setMemoryFile(fd, name);
+
+    // A new inode is loaded: its reload capability has to be tested again.
+    m_impl->lib.reload_capability_tested = false;
+    m_impl->lib.can_reload = true;
+
+    if (!m_impl->loadInternal())
+    {
+        m_impl->error_message =
+            "Failed to reload library '" + name + "': " + m_impl->error_message;
+        m_impl->publish(LibraryEvent::ReloadFailed);
+        return false;
+    }
+    m_impl->publish(LibraryEvent::PostReload);
+    return true;
+}
+
+//!----------------------------------------------------------------------------
+void DynamicLibrary::setAutoReload(AutoReload p_enable)
+{
+    std::lock_guard<std::mutex> lock(m_impl->mutex);
+    m_impl->auto_reload = p_enable;
+}
+
+//!----------------------------------------------------------------------------
+void DynamicLibrary::setHugePageText(HugePages p_enable)
+{
+    std::lock_guard<std::mutex> lock(m_impl->mutex);
+    m_impl->huge_pages = p_enable;
+}
+
+//!----------------------------------------------------------------------------
+std::size_t DynamicLibrary::getHugePageTextSize() const
+{
+    std::lock_guard<std::mutex> lock(m_impl->mutex);
+    return m_impl->lib.huge_text;
+}
+
+//!----------------------------------------------------------------------------
+bool DynamicLibrary::canReload() const
+{
+    Implementation::StatusLock lock(*m_impl);
+    return m_impl->canReload();
+}
+
+//!----------------------------------------------------------------------------
+std::string DynamicLibrary::getPath() const
+{
+    return m_impl->status.read(
+        [](const Implementation::Status& p_status) { return p_status.path; });
+}
+
+//!----------------------------------------------------------------------------
+std::string DynamicLibrary::getErrorMessage() const
+{
+    return m_impl->status.read(
+        [](const Implementation::Status& p_status)
+        { return p_status.error_message; });
+}
+
+//!----------------------------------------------------------------------------
+std::chrono::steady_clock::time_point DynamicLibrary::getLastUse() const
+{
+    return m_impl->last_use.load();
+}
+
+//!----------------------------------------------------------------------------
+std::uint64_t DynamicLibrary::getLoadGeneration() const
+{
+    return m_impl->load_generation.load(std::memory_order_acquire);
+}
+
+//!----------------------------------------------------------------------------
+std::size_t DynamicLibrary::getMappedSize() const
+{
+    std::lock_guard<std::mutex> lock(m_impl->mutex);
+    return m_impl->mappedSize();
+}
+
+//!----------------------------------------------------------------------------
+MemoryFootprint DynamicLibrary::getMemoryFootprint() const
+{
+#ifdef __linux__
+    auto ranges = readResidentRanges();
+    std::lock_guard<std::mutex> lock(m_impl->mutex);
+    return m_impl->memoryFootprint(ranges);
+#else
+    return MemoryFootprint();
+#endif
+}
+
+//!----------------------------------------------------------------------------
+std::string DynamicLibrary::getBuildId() const
+{
+    std::lock_guard<std::mutex> lock(m_impl->mutex);
+    return m_impl->lib.build_id;
+}
+
+//!----------------------------------------------------------------------------
+long DynamicLibrary::getNamespaceId() const
+{
+    std::lock_guard<std::mutex> lock(m_impl->mutex);
+    return m_impl->lib.namespace_id;
+}
+
+//!----------------------------------------------------------------------------
+NamespaceReport DynamicLibrary::getNamespaceReport() const
+{
+    std::lock_guard<std::mutex> lock(m_impl->mutex);
+    return m_impl->namespaceReport();
+}
+
+//!----------------------------------------------------------------------------
+void DynamicLibrary::setMaxIsolatedNamespaces(std::size_t p_max)
+{
+    NamespaceRegistry::instance().setLimit(p_max);
+}
+
+//!----------------------------------------------------------------------------
+void DynamicLibrary::setSymbolCacheDirectory(const std::string& p_directory)
+{
+    auto& settings = SymbolCacheSettings::instance();
+    std::lock_guard<std::mutex> lock(settings.mutex);
+    settings.path = p_directory;
+}
+
+//!----------------------------------------------------------------------------
+bool DynamicLibrary::touch()
+{
+    Implementation::StatusLock lock(*m_impl);
+    if (!m_impl->lib.in_memory)
+    {
+        m_impl->lib.signature = m_impl->getFileSignature(m_impl->lib.path);
+    }
+    if (m_impl->auto_reload == AutoReload::Enabled)
+    {
+        return m_impl->reloadInternal();
+    }
+    return true;
+}
+
+//!----------------------------------------------------------------------------
+LibraryMetrics DynamicLibrary::getMetrics() const
+{
+    return m_impl->metrics.snapshot();
+}
+
+//!----------------------------------------------------------------------------
+void DynamicLibrary::setMetricsRecording(MetricsRecording p_mode)
+{
+    m_impl->metrics.enable(p_mode == MetricsRecording::Enabled);
+}
+
+//!----------------------------------------------------------------------------
+SubscriptionId DynamicLibrary::subscribe(EventCallback p_callback)
+{
+    return m_impl->eventHub().subscribe(std::move(p_callback));
+}
+
+//!----------------------------------------------------------------------------
+void DynamicLibrary::unsubscribe(SubscriptionId p_id)
+{
+    m_impl->eventHub().unsubscribe(p_id);
+}
+
+//!----------------------------------------------------------------------------
+void DynamicLibrary::setEventExecutor(EventExecutor p_executor)
+{
+    m_impl->eventHub().setExecutor(std::move(p_executor));
+}
+
+//!----------------------------------------------------------------------------
+std::size_t DynamicLibrary::dispatchEvents()
+{
+    EventHub* hub = m_impl->events_hub.load(std::memory_order_acquire);
+    return hub ? hub->dispatch() : 0u;
+}
+
+//!----------------------------------------------------------------------------
+DynamicLibraryManager::DynamicLibraryManager() noexcept
+    : m_impl(std::make_unique<Implementation>())
+{
+}
+
+//!----------------------------------------------------------------------------
+DynamicLibraryManager::~DynamicLibraryManager() = default;
+
+//!----------------------------------------------------------------------------
+std::shared_ptr<DynamicLibrary>
+DynamicLibraryManager::loadLibrary(const std::string& p_name,
+                                   const std::string& p_path,
+                                   AutoReload p_auto_reload,
+                                   LinkNamespace p_namespace)
+{
+    LibraryHandle handle;
+    return loadLibrary(p_name, p_path, p_auto_reload, handle, p_namespace);
+}
+
+//!----------------------------------------------------------------------------
+std::shared_ptr<DynamicLibrary>
+DynamicLibraryManager::loadLibrary(const std::string& p_name,
+                                   const std::string& p_path,
+                                   AutoReload p_auto_reload,
+                                   LibraryHandle& p_handle,
+                                   LinkNamespace p_namespace)
+{
+    if (auto lib = m_impl->find(p_name, p_handle))
+    {
+        return lib;
+    }
+
+    std::unique_lock<std::mutex> lock(m_impl->m_mutex);
+    m_impl->waitLoading(lock, p_name);
+
+    if (auto library = m_impl->find(p_name, p_handle))
+    {
+        return library;
+    }
+
+    // Attached first, so that the library is loaded by the loader thread
+    auto lib = std::make_shared<DynamicLibrary>();
+    m_impl->attach(p_name, *lib);
+    std::string path = m_impl->resolvePath(p_path);
+
+    Implementation::Reservation reservation(*m_impl, lock);
+    reservation.add(p_name);
+    lock.unlock();
+    if (!lib->load(path, p_auto_reload, p_namespace))
+    {
+        throw DynamicLibraryException(lib->getErrorMessage());
+    }
+    lock.lock();
+
+    // The recording may have been switched during the load
+    lib->setMetricsRecording(m_impl->m_metrics_recording);
+    m_impl->m_libraries.update(
+        [&](Implementation::Libraries& p_libraries)
+        { p_handle = p_libraries.insert(p_name, lib); });
+    m_impl->m_generation->fetch_add(1u);
+    m_impl->watchLibrary(p_name, lib);
+    m_impl->enforceMemoryBudget(lib.get());
+    reservation.release();
+    m_impl->scheduleEvents(lock);
+
+    return lib;
+}
+
+//!----------------------------------------------------------------------------
+void DynamicLibraryManager::addSearchPath(const std::string& p_directory)
+{
+    std::lock_guard<std::mutex> lock(m_impl->m_mutex);
+
+    std::string path = p_directory;
+    while ((path.size() > 1u) && (path.back() == '/'))
+    {
+        path.pop_back();
+    }
+
+    for (const auto& directory : m_impl->m_search_directories)
+    {
+        if (directory.path == path)
+        {
+            return;
+        }
+    }
+
+    m_impl->m_search_directories.emplace_back();
+    auto& directory = m_impl->m_search_directories.back();
+    directory.path = path;
+
+    m_impl->rearmDirectory(directory);
+}
+
+//!----------------------------------------------------------------------------
+std::string DynamicLibraryManager::resolve(const std::string& p_name)
+{
+    std::lock_guard<std::mutex> lock(m_impl->m_mutex);
+    return m_impl->resolve(p_name);
+}
+
+//!----------------------------------------------------------------------------
+std::shared_ptr<DynamicLibrary>
+DynamicLibraryManager::registerLibrary(const std::string& p_name,
+                                       const std::string& p_path,
+                                       AutoReload p_auto_reload,
+                                       LinkNamespace p_namespace)
+{
+    LibraryHandle handle;
+    return registerLibrary(p_name, p_path, p_auto_reload, handle, p_namespace);
+}
+
+//!----------------------------------------------------------------------------
+std::shared_ptr<DynamicLibrary>
+DynamicLibraryManager::registerLibrary(const std::string& p_name,
+                                       const std::string& p_path,
+                                       AutoReload p_auto_reload,
+                                       LibraryHandle& p_handle,
+                                       LinkNamespace p_namespace)
+{
+    if (auto lib = m_impl->find(p_name, p_handle))
+    {
+        return lib;
+    }
+
+    std::unique_lock<std::mutex> lock(m_impl->m_mutex);
+    m_impl->waitLoading(lock, p_name);
+
+    if (auto library = m_impl->find(p_name, p_handle))
+    {
+        return library;
+    }
+
+    auto lib = std::make_shared<DynamicLibrary>();
+    std::string path = m_impl->resolvePath(p_path);
+
+    Implementation::Reservation reservation(*m_impl, lock);
+    reservation.add(p_name);
+    lock.unlock();
+    if (!lib->loadLazy(path, p_auto_reload, p_namespace))
+    {
+        throw DynamicLibraryException(lib->getErrorMessage());
+    }
+    lock.lock();
+
+    m_impl->attach(p_name, *lib);
+    m_impl->m_libraries.update(
+        [&](Implementation::Libraries& p_libraries)
+        { p_handle = p_libraries.insert(p_name, lib); });
+    m_impl->m_generation->fetch_add(1u);
+    m_impl->watchLibrary(p_name, lib);
+
+    return lib;
+}
+
+//!----------------------------------------------------------------------------
+std::size_t DynamicLibraryManager::loadArchive(const std::string& p_path)
+{
+    PluginArchive archive;
+    if (!archive.open(p_path))
+    {
+        throw DynamicLibraryException(archive.getErrorMessage());
+    }
+
+    std::unique_lock<std::mutex> lock(m_impl->m_mutex);
+    m_impl->m_loaded.wait(
+        lock,
+        [this, &archive]()
+        {
+            for (const auto& entry : archive.getEntries())
+            {
+                if (m_impl->m_loading.count(entry.name) != 0u)
+                {
+                    return false;
+                }
+            }
+            return true;
+        });
+
+    //! \brief New or modified entry, with the library it replaces (if any)
+    struct StagedEntry
+    {
+        const PluginArchive::Entry* entry;
+        std::shared_ptr<DynamicLibrary> current;
+        std::shared_ptr<DynamicLibrary> library;
+    };
+
+    // Check all the entries before touching any library
+    std::vector<StagedEntry> staged;
+    std::unordered_set<std::string> names;
+    for (const auto& entry : archive.getEntries())
+    {
+        if (entry.name.empty() || !names.insert(entry.name).second)
+        {
+            throw DynamicLibraryException(
+                "Plugin archive '" + p_path +
+                "' has an empty or duplicate entry name '" + entry.name + "'");
+        }
+
+        std::shared_ptr<DynamicLibrary> current;
+        if (auto library = m_impl->m_libraries.get().find(entry.name))
+        {
+            auto hash = m_impl->m_archive_hashes.find(entry.name);
+            if (hash == m_impl->m_archive_hashes.end())
             {
-                lib.can_reload = (dlclose(test_handle) == 0);
+                throw DynamicLibraryException(
+                    "Library '" + entry.name + "' of plugin archive '" +
+                    p_path + "' is already loaded from a file");
             }
-            else
+            if (hash->second == entry.hash)
             {
-                lib.can_reload = false;
+                continue;
+            }
+            current = *library;
+            if (!current->canReload())
+            {
+                throw DynamicLibraryException(current->getErrorMessage());
             }
         }
-#endif
 
-        return lib.can_reload;
+        if (PluginArchive::hash(archive.getData(entry),
+                                static_cast<std::size_t>(entry.size)) !=
+            entry.hash)
+        {
+            throw DynamicLibraryException("Entry '" + entry.name +
+                                          "' of plugin archive '" + p_path +
+                                          "' is corrupted");
+        }
+        staged.push_back({ &entry, std::move(current), nullptr });
     }
 
-    //!------------------------------------------------------------------------
-    //! \brief Reload the library
-    //! \return True if successful, false otherwise
-    //!------------------------------------------------------------------------
-    bool reloadInternal()
+    // Load the new builds next to the current ones: on error the staged
+    // libraries are dropped and the manager is left untouched
+    Implementation::Reservation reservation(*m_impl, lock);
+    for (const auto& item : staged)
     {
-        // First check if the reload is possible
-        if (!canReload())
+        reservation.add(item.entry->name);
+    }
+    lock.unlock();
+    for (auto& item : staged)
+    {
+        item.library = std::make_shared<DynamicLibrary>();
+        // Attached once committed, but loaded by the loader thread already
+        item.library->m_impl->loader = m_impl->m_loader;
+        if (!item.library->loadFromMemory(
+                archive.getData(*item.entry),
+                static_cast<std::size_t>(item.entry->size),
+                item.entry->name))
         {
-            error_message =
-                "Library cannot be reloaded - reload capability not supported";
-            return false;
+            throw DynamicLibraryException(item.library->getErrorMessage());
         }
+    }
+    lock.lock();
 
-        std::string path = lib.path;
-
-        // Attempt to unload
-        if (!unloadInternal())
+    // Commit: nothing can fail from here on
+    std::vector<std::pair<std::string, std::shared_ptr<DynamicLibrary>>>
+        added;
+    for (auto& item : staged)
+    {
+        if (item.current)
         {
-            error_message = "Warning: Unload failed, attempting reload anyway";
+            auto& impl = *item.current->m_impl;
+            DynamicLibrary::Implementation::StatusLock library_lock(impl);
+            library_lock.deferEvents();
+            m_impl->m_pending_events.push_back(item.current);
+            impl.replaceBuild(*item.library->m_impl);
+        }
+        else
+        {
+            m_impl->attach(item.entry->name, *item.library);
+            added.emplace_back(item.entry->name, std::move(item.library));
         }
+        m_impl->m_archive_hashes[item.entry->name] = item.entry->hash;
+    }
 
-        // Small pause to let the system stabilize
-        std::this_thread::sleep_for(std::chrono::milliseconds(10));
+    // Publish the new libraries at once rather than copying the map for each
+    if (!added.empty())
+    {
+        m_impl->m_libraries.update(
+            [&added](Implementation::Libraries& p_libraries)
+            {
+                for (auto& library_pair : added)
+                {
+                    p_libraries.insert(library_pair.first,
+                                       std::move(library_pair.second));
+                }
+            });
+        m_impl->m_generation->fetch_add(1u);
+    }
+    reservation.release();
+    m_impl->scheduleEvents(lock);
 
-        // Reload
-        lib.path = path;
-        lib.last_modified = getFileModificationTime(path);
+    // Libraries were copied into their memory files: the mapping can go.
+    return staged.size();
+}
 
-        bool success = loadInternal();
-        if (!success)
+//!----------------------------------------------------------------------------
+std::vector<PluginMetadata>
+DynamicLibraryManager::discoverPlugins(const std::string& p_directory,
+                                       const std::string& p_index_path) const
+{
+    std::vector<std::string> files;
+#ifndef _WIN32
+    DIR* dir = opendir(p_directory.c_str());
+    if (!dir)
+    {
+        return {};
+    }
+    const std::string extension(LIB_EXTENSION);
+    while (struct dirent* entry = readdir(dir))
+    {
+        std::string file(entry->d_name);
+        if ((file.size() > extension.size()) &&
+            (file.compare(file.size() - extension.size(),
+                          extension.size(),
+                          extension) == 0))
         {
-            error_message =
-                "Failed to reload library '" + path + "': " + error_message;
+            files.push_back(std::move(file));
         }
-
-        return success;
     }
+    closedir(dir);
+#endif
+    std::sort(files.begin(), files.end());
 
-}; // DynamicLibrary::Implementation
+    using IndexedPlugin = Implementation::IndexedPlugin;
+    auto index = p_index_path.empty()
+                     ? std::unordered_map<std::string, IndexedPlugin>()
+                     : Implementation::loadPluginIndex(p_index_path,
+                                                       p_directory);
 
-//! ***************************************************************************
-//! \brief Implementation of DynamicLibraryManager
-//! ***************************************************************************
-class DynamicLibraryManager::Implementation
-{
-public:
+    // Only the files whose signature changed since the index was written
+    // are read again.
+    std::vector<IndexedPlugin> plugins(files.size());
+    std::vector<char> changed(files.size(), 0);
+    m_impl->parallelFor(
+        files.size(),
+        [&](std::size_t p_index)
+        {
+            std::string path = p_directory + "/" + files[p_index];
+            IndexedPlugin& plugin = plugins[p_index];
+            plugin.signature =
+                DynamicLibrary::Implementation::getFileSignature(path);
 
-    std::unordered_map<std::string, std::unique_ptr<DynamicLibrary>>
-        m_libraries;
-    mutable std::mutex m_mutex;
-};
+            auto it = index.find(files[p_index]);
+            if ((it != index.end()) &&
+                (it->second.signature == plugin.signature) &&
+                (plugin.signature.size != 0u))
+            {
+                plugin.has_metadata = it->second.has_metadata;
+                plugin.metadata = it->second.metadata;
+                plugin.metadata.path = path;
+                return;
+            }
+            plugin.has_metadata = readPluginMetadata(path, plugin.metadata);
+            changed[p_index] = 1;
+        });
 
-//!----------------------------------------------------------------------------
-DynamicLibrary::DynamicLibrary() noexcept
-    : m_impl(std::make_unique<Implementation>())
-{
+    if (!p_index_path.empty() &&
+        ((index.size() != files.size()) ||
+         (std::find(changed.begin(), changed.end(), 1) != changed.end())))
+    {
+        Implementation::savePluginIndex(
+            p_index_path, p_directory, files, plugins);
+    }
+
+    std::vector<PluginMetadata> result;
+    for (auto& plugin : plugins)
+    {
+        if (plugin.has_metadata)
+        {
+            result.push_back(std::move(plugin.metadata));
+        }
+    }
+    return result;
 }
 
 //!----------------------------------------------------------------------------
-DynamicLibrary::DynamicLibrary(const std::string& p_library_path,
-                               AutoReload p_auto_reload)
-    : m_impl(std::make_unique<Implementation>())
+std::shared_ptr<DynamicLibrary>
+DynamicLibraryManager::findProvider(const std::string& p_symbol_name)
 {
-    if (!load(p_library_path, p_auto_reload))
     {
-        throw DynamicLibraryException(m_impl->error_message);
+        std::shared_lock<std::shared_timed_mutex> lock(
+            m_impl->m_symbols_mutex);
+        if (m_impl->m_symbols_generation == m_impl->m_generation->load())
+        {
+            auto it = m_impl->m_symbols.find(p_symbol_name);
+            return (it != m_impl->m_symbols.end())
+                       ? it->second.front().library
+                       : nullptr;
+        }
     }
-}
 
-//!----------------------------------------------------------------------------
-DynamicLibrary::~DynamicLibrary() = default;
+    std::unique_lock<std::shared_timed_mutex> lock(m_impl->m_symbols_mutex);
+    m_impl->refreshSymbols();
+    auto it = m_impl->m_symbols.find(p_symbol_name);
+    return (it != m_impl->m_symbols.end()) ? it->second.front().library
+                                           : nullptr;
+}
 
 //!----------------------------------------------------------------------------
-DynamicLibrary::DynamicLibrary(DynamicLibrary&& p_other) noexcept
-    : m_impl(std::move(p_other.m_impl))
+std::vector<std::string>
+DynamicLibraryManager::findProviders(const std::string& p_symbol_name)
 {
+    std::unique_lock<std::shared_timed_mutex> lock(m_impl->m_symbols_mutex);
+    m_impl->refreshSymbols();
+
+    std::vector<std::string> names;
+    auto it = m_impl->m_symbols.find(p_symbol_name);
+    if (it != m_impl->m_symbols.end())
+    {
+        for (const auto& provider : it->second)
+        {
+            names.push_back(provider.name);
+        }
+    }
+    return names;
 }
 
 //!----------------------------------------------------------------------------
-DynamicLibrary& DynamicLibrary::operator=(DynamicLibrary&& p_other) noexcept
+void DynamicLibraryManager::setProviderPriority(const std::string& p_name,
+                                                int p_priority)
 {
-    if (this != &p_other)
+    std::unique_lock<std::shared_timed_mutex> lock(m_impl->m_symbols_mutex);
+    m_impl->m_priorities[p_name] = p_priority;
+
+    // Sort the symbols of the library again if it is already indexed
+    auto it = m_impl->m_indexed_libraries.find(p_name);
+    if (it != m_impl->m_indexed_libraries.end())
     {
-        m_impl = std::move(p_other.m_impl);
+        m_impl->removeProvider(p_name, it->second.symbols);
+        m_impl->addProvider(p_name, it->second.library, it->second.symbols);
     }
-    return *this;
+
+    // The resolved functions are sorted by priority too
+    std::lock_guard<std::mutex> functions_lock(m_impl->m_functions_mutex);
+    m_impl->m_functions.clear();
 }
 
 //!----------------------------------------------------------------------------
-bool DynamicLibrary::load(const std::string& p_library_path,
-                          AutoReload p_auto_reload)
+std::shared_ptr<const std::vector<DynamicLibraryManager::FunctionTarget>>
+DynamicLibraryManager::resolveAll(const std::string& p_function_name)
 {
-    std::lock_guard<std::mutex> lock(m_impl->mutex);
-
-    if (m_impl->lib.handle)
+    // Read first: a library loaded meanwhile makes the result stale
+    const std::uint64_t generation = m_impl->m_generation->load();
     {
-        m_impl->unloadInternal(); // On ignore le résultat
+        std::lock_guard<std::mutex> lock(m_impl->m_functions_mutex);
+        auto it = m_impl->m_functions.find(p_function_name);
+        if ((it != m_impl->m_functions.end()) &&
+            (it->second.generation == generation))
+        {
+            return it->second.targets;
+        }
     }
 
-    if (!m_impl->validatePath(p_library_path))
+    std::vector<Implementation::SymbolProvider> providers;
     {
-        return false;
+        std::unique_lock<std::shared_timed_mutex> lock(
+            m_impl->m_symbols_mutex);
+        m_impl->refreshSymbols();
+        auto it = m_impl->m_symbols.find(p_function_name);
+        if (it != m_impl->m_symbols.end())
+        {
+            providers = it->second;
+        }
     }
 
-    m_impl->lib.path = p_library_path;
-    m_impl->lib.last_modified = m_impl->getFileModificationTime(p_library_path);
-    m_impl->auto_reload = p_auto_reload;
+    auto targets = std::make_shared<std::vector<FunctionTarget>>();
+    for (auto& provider : providers)
+    {
+        // Read first: a reload meanwhile makes the address stale
+        std::uint64_t load_generation = provider.library->getLoadGeneration();
+        void* function =
+            provider.library->getSymbol<void*>(p_function_name);
+        if (function)
+        {
+            targets->push_back(FunctionTarget{ std::move(provider.name),
+                                               std::move(provider.library),
+                                               function,
+                                               load_generation });
+        }
+    }
 
-    return m_impl->loadInternal();
+    std::lock_guard<std::mutex> lock(m_impl->m_functions_mutex);
+    auto& resolved = m_impl->m_functions[p_function_name];
+    resolved.generation = generation;
+    resolved.targets = targets;
+    return targets;
 }
 
 //!----------------------------------------------------------------------------
-bool DynamicLibrary::unload()
+void DynamicLibraryManager::callTarget(
+    const FunctionTarget& p_target,
+    const std::string& p_function_name,
+    const std::function<void(void*)>& p_call)
 {
-    std::lock_guard<std::mutex> lock(m_impl->mutex);
-    return m_impl->unloadInternal();
+    auto& impl = *p_target.owner->m_impl;
+    void* function = p_target.function;
+    std::uint64_t load_generation = p_target.load_generation;
+    for (;;)
+    {
+        {
+            std::shared_lock<std::shared_timed_mutex> code_lock(
+                impl.code_mutex);
+            if (impl.load_generation.load() == load_generation)
+            {
+                impl.last_use.store(std::chrono::steady_clock::now(),
+                                    std::memory_order_relaxed);
+                DynamicLibrary::Implementation::CallScope scope(impl);
+                p_call(function);
+                return;
+            }
+        }
+
+        // Reloaded or evicted since the resolution: resolve the function
+        // again, which loads an evicted library back
+        load_generation = impl.load_generation.load();
+        function = p_target.owner->getSymbol<void*>(p_function_name);
+        if (!function)
+        {
+            throw DynamicLibraryException(p_target.owner->getErrorMessage());
+        }
+    }
 }
 
 //!----------------------------------------------------------------------------
-bool DynamicLibrary::isLoaded() const
+void DynamicLibraryManager::invokeEach(
+    std::size_t p_count,
+    InvokeOrder p_order,
+    const std::function<void(std::size_t)>& p_task)
 {
-    std::lock_guard<std::mutex> lock(m_impl->mutex);
-    return m_impl->lib.handle != nullptr;
+    // A single call is not worth a hand-off to the pool
+    if ((p_order == InvokeOrder::Deterministic) || (p_count < 2u))
+    {
+        std::exception_ptr error;
+        for (std::size_t i = 0u; i < p_count; ++i)
+        {
+            try
+            {
+                p_task(i);
+            }
+            catch (...)
+            {
+                if (!error)
+                {
+                    error = std::current_exception();
+                }
+            }
+        }
+        if (error)
+        {
+            std::rethrow_exception(error);
+        }
+        return;
+    }
+
+    m_impl->pool().run(p_count, p_task);
 }
 
 //!----------------------------------------------------------------------------
-void* DynamicLibrary::getSymbolInternal(const std::string& p_symbol_name)
+std::vector<std::pair<std::string, LibraryMetrics>>
+DynamicLibraryManager::getMetrics() const
 {
-    std::lock_guard<std::mutex> lock(m_impl->mutex);
+    std::vector<std::pair<std::string, LibraryMetrics>> metrics;
+    for (const auto& library_pair : m_impl->namedSnapshot())
+    {
+        metrics.emplace_back(library_pair.first,
+                             library_pair.second->getMetrics());
+    }
+    std::sort(metrics.begin(),
+              metrics.end(),
+              [](const auto& p_a, const auto& p_b)
+              { return p_a.first < p_b.first; });
+    return metrics;
+}
 
-    if (!m_impl->lib.handle)
+//!----------------------------------------------------------------------------
+void DynamicLibraryManager::setMetricsRecording(MetricsRecording p_mode)
+{
+    std::lock_guard<std::mutex> lock(m_impl->m_mutex);
+    m_impl->m_metrics_recording = p_mode;
+    for (const auto& library : m_impl->snapshot())
     {
-        m_impl->error_message = "Library not loaded";
-        return nullptr;
+        library->setMetricsRecording(p_mode);
     }
+}
 
-    if ((m_impl->auto_reload == AutoReload::Enabled) && m_impl->needsReload())
+//!----------------------------------------------------------------------------
+bool DynamicLibraryManager::dumpMetrics(const std::string& p_path) const
+{
+    auto escape = [](const std::string& p_value)
     {
-        if (!m_impl->reloadInternal())
+        std::string escaped;
+        for (char c : p_value)
         {
-            return nullptr;
+            if ((c == '\\') || (c == '"'))
+            {
+                escaped += '\\';
+                escaped += c;
+            }
+            else if (c == '\n')
+            {
+                escaped += "\\n";
+            }
+            else
+            {
+                escaped += c;
+            }
         }
-    }
+        return escaped;
+    };
 
-    auto it = m_impl->lib.symbol_cache.find(p_symbol_name);
-    if (it != m_impl->lib.symbol_cache.end())
+    std::string tmp_path = temporaryPath(p_path);
     {
-        return it->second;
-    }
+        std::ofstream file(tmp_path, std::ios::trunc);
+        file << "# HELP dl_operation_duration_seconds Duration of the "
+                "operations made on the dynamic libraries.\n"
+                "# TYPE dl_operation_duration_seconds histogram\n";
+        for (const auto& library_pair : getMetrics())
+        {
+            const LibraryMetrics& metrics = library_pair.second;
+            const std::pair<const char*, const LatencyHistogram*>
+                operations[] = { { "load", &metrics.load },
+                                 { "lookup_hit", &metrics.lookup_hit },
+                                 { "lookup_miss", &metrics.lookup_miss },
+                                 { "reload", &metrics.reload },
+                                 { "unload", &metrics.unload },
+                                 { "reload_probe", &metrics.reload_probe } };
+            for (const auto& operation : operations)
+            {
+                const LatencyHistogram& histogram = *operation.second;
+                // The shards are read without lock: the count of a snapshot
+                // may lag behind its buckets, whose sum is used instead
+                std::uint64_t count = 0u;
+                for (std::uint64_t bucket : histogram.buckets)
+                {
+                    count += bucket;
+                }
+                if (count == 0u)
+                {
+                    continue;
+                }
+                std::string labels = "library=\"" +
+                                     escape(library_pair.first) +
+                                     "\",operation=\"" + operation.first +
+                                     "\"";
 
-    void* symbol = m_impl->getSymbolInternal(p_symbol_name);
-    if (symbol)
-    {
-        m_impl->lib.symbol_cache[p_symbol_name] = symbol;
+                // Buckets are cumulative, bounded by their inclusive upper
+                // limit: bucket i ends at 2^(i+1) - 1 ns
+                std::uint64_t cumulative = 0u;
+                for (std::size_t i = 0u; i + 1u < LatencyHistogram::BUCKETS;
+                     ++i)
+                {
+                    cumulative += histogram.buckets[i];
+                    file << "dl_operation_duration_seconds_bucket{" << labels
+                         << ",le=\""
+                         << double((std::uint64_t(2) << i) - 1u) * 1e-9
+                         << "\"} " << cumulative << '\n';
+                }
+                file << "dl_operation_duration_seconds_bucket{" << labels
+                     << ",le=\"+Inf\"} " << count << '\n'
+                     << "dl_operation_duration_seconds_sum{" << labels << "} "
+                     << double(histogram.total_ns) * 1e-9 << '\n'
+                     << "dl_operation_duration_seconds_count{" << labels
+                     << "} " << count << '\n';
+            }
+        }
+        if (!file.good())
+        {
+            std::remove(tmp_path.c_str());
+            return false;
+        }
     }
+    return std::rename(tmp_path.c_str(), p_path.c_str()) == 0;
+}
 
-    return symbol;
+//!----------------------------------------------------------------------------
+SubscriptionId DynamicLibraryManager::subscribe(EventCallback p_callback)
+{
+    return m_impl->m_events->subscribe(std::move(p_callback));
 }
 
 //!----------------------------------------------------------------------------
-bool DynamicLibrary::checkForUpdates() const
+void DynamicLibraryManager::unsubscribe(SubscriptionId p_id)
 {
-    std::lock_guard<std::mutex> lock(m_impl->mutex);
-    return m_impl->needsReload();
+    m_impl->m_events->unsubscribe(p_id);
 }
 
 //!----------------------------------------------------------------------------
-bool DynamicLibrary::reload()
+void DynamicLibraryManager::setEventExecutor(EventExecutor p_executor)
 {
-    std::lock_guard<std::mutex> lock(m_impl->mutex);
-    return m_impl->lib.handle && m_impl->reloadInternal();
+    m_impl->m_events->setExecutor(std::move(p_executor));
 }
 
 //!----------------------------------------------------------------------------
-void DynamicLibrary::setAutoReload(AutoReload p_enable)
+std::size_t DynamicLibraryManager::dispatchEvents()
 {
-    std::lock_guard<std::mutex> lock(m_impl->mutex);
-    m_impl->auto_reload = p_enable;
+    return m_impl->m_events->dispatch();
 }
 
 //!----------------------------------------------------------------------------
-bool DynamicLibrary::canReload() const
+void DynamicLibraryManager::unloadLibrary(const std::string& p_name)
 {
-    std::lock_guard<std::mutex> lock(m_impl->mutex);
-    return m_impl->canReload();
+    std::unique_lock<std::mutex> lock(m_impl->m_mutex);
+    m_impl->waitLoading(lock, p_name);
+    if (auto library = m_impl->m_libraries.get().find(p_name))
+    {
+        m_impl->unwatchLibrary(p_name, *library);
+
+        // The library is destroyed when its last user releases it
+        m_impl->m_libraries.update(
+            [&p_name](Implementation::Libraries& p_libraries)
+            { p_libraries.erase(p_name); });
+
+        // Its symbols must leave the index even if it stays loaded. The
+        // generation change undoes a refresh which raced with the removal.
+        m_impl->unindexLibrary(p_name);
+        m_impl->m_generation->fetch_add(1u);
+
+        // Nor should the resolved functions keep it alive
+        std::lock_guard<std::mutex> functions_lock(m_impl->m_functions_mutex);
+        m_impl->m_functions.clear();
+    }
+    m_impl->m_archive_hashes.erase(p_name);
 }
 
 //!----------------------------------------------------------------------------
-std::string DynamicLibrary::getErrorMessage() const
+std::shared_ptr<DynamicLibrary>
+DynamicLibraryManager::getLibrary(const std::string& p_name)
 {
-    std::lock_guard<std::mutex> lock(m_impl->mutex);
-    return m_impl->error_message;
+    return m_impl->find(p_name);
 }
 
 //!----------------------------------------------------------------------------
-bool DynamicLibrary::touch()
+LibraryHandle DynamicLibraryManager::getHandle(const std::string& p_name) const
 {
-    std::lock_guard<std::mutex> lock(m_impl->mutex);
-    m_impl->lib.last_modified = std::chrono::system_clock::now();
-    if (m_impl->auto_reload == AutoReload::Enabled)
-    {
-        return m_impl->reloadInternal();
-    }
-    return true;
+    return m_impl->m_libraries.read(
+        [&p_name](const Implementation::Libraries& p_libraries)
+        { return p_libraries.handle(p_name); });
 }
 
 //!----------------------------------------------------------------------------
-DynamicLibraryManager::DynamicLibraryManager() noexcept
-    : m_impl(std::make_unique<Implementation>())
+std::shared_ptr<DynamicLibrary>
+DynamicLibraryManager::getLibrary(LibraryHandle p_handle) const
 {
+    return m_impl->get(p_handle);
 }
 
 //!----------------------------------------------------------------------------
-DynamicLibraryManager::~DynamicLibraryManager() = default;
+bool DynamicLibraryManager::checkAllForUpdates()
+{
+    return !findUpdatedLibraries().empty();
+}
 
 //!----------------------------------------------------------------------------
-std::shared_ptr<DynamicLibrary>
-DynamicLibraryManager::loadLibrary(const std::string& p_name,
-                                   const std::string& p_path,
-                                   AutoReload p_auto_reload)
+std::vector<std::string> DynamicLibraryManager::findUpdatedLibraries() const
 {
-    std::lock_guard<std::mutex> lock(m_impl->m_mutex);
+    auto libraries = m_impl->namedSnapshot();
+
+    // Each call writes the result of its own library
+    std::vector<char> updated(libraries.size(), 0);
+    m_impl->parallelFor(
+        libraries.size(),
+        [&libraries, &updated](std::size_t p_index)
+        {
+            updated[p_index] =
+                libraries[p_index].second->checkForUpdates() ? 1 : 0;
+        });
+
+    std::vector<std::string> names;
+    for (std::size_t i = 0u; i < libraries.size(); ++i)
+    {
+        if (updated[i])
+        {
+            names.push_back(std::move(libraries[i].first));
+        }
+    }
+    return names;
+}
 
-    auto it = m_impl->m_libraries.find(p_name);
-    if (it != m_impl->m_libraries.end())
+//!----------------------------------------------------------------------------
+std::vector<std::string> DynamicLibraryManager::reloadUpdatedLibraries()
+{
+    std::vector<std::string> reloaded;
+    for (auto& name : findUpdatedLibraries())
     {
-        return std::shared_ptr<DynamicLibrary>(it->second.get(),
-                                               [](DynamicLibrary*) {});
+        auto library = m_impl->find(name);
+        if (library && library->reload())
+        {
+            reloaded.push_back(std::move(name));
+        }
     }
+    return reloaded;
+}
 
-    auto lib = std::make_unique<DynamicLibrary>(p_path, p_auto_reload);
-    auto ptr = lib.get();
-    m_impl->m_libraries[p_name] = std::move(lib);
+//!----------------------------------------------------------------------------
+void DynamicLibraryManager::setLoaderService(LoaderService p_mode)
+{
+    std::lock_guard<std::mutex> lock(m_impl->m_mutex);
+    if (p_mode == LoaderService::Enabled)
+    {
+        m_impl->m_loader->start();
+    }
+    else
+    {
+        m_impl->m_loader->stop();
+    }
+}
 
-    return std::shared_ptr<DynamicLibrary>(ptr, [](DynamicLibrary*) {});
+//!----------------------------------------------------------------------------
+void DynamicLibraryManager::setMemoryBudget(
+    std::size_t p_bytes,
+    std::chrono::milliseconds p_min_idle)
+{
+    std::unique_lock<std::mutex> lock(m_impl->m_mutex);
+    m_impl->m_memory_budget = p_bytes;
+    m_impl->m_min_idle = p_min_idle;
+    m_impl->enforceMemoryBudget();
+    m_impl->scheduleEvents(lock);
 }
 
 //!----------------------------------------------------------------------------
-void DynamicLibraryManager::unloadLibrary(const std::string& p_name)
+std::size_t DynamicLibraryManager::enforceMemoryBudget()
 {
-    std::lock_guard<std::mutex> lock(m_impl->m_mutex);
-    m_impl->m_libraries.erase(p_name);
+    std::unique_lock<std::mutex> lock(m_impl->m_mutex);
+    std::size_t evicted = m_impl->enforceMemoryBudget();
+    m_impl->scheduleEvents(lock);
+    return evicted;
 }
 
 //!----------------------------------------------------------------------------
-std::shared_ptr<DynamicLibrary>
-DynamicLibraryManager::getLibrary(const std::string& p_name)
+MemoryFootprint DynamicLibraryManager::getMemoryFootprint() const
 {
-    std::lock_guard<std::mutex> lock(m_impl->m_mutex);
-    auto it = m_impl->m_libraries.find(p_name);
-    if (it != m_impl->m_libraries.end())
+    MemoryFootprint total;
+#ifdef __linux__
+    auto ranges = readResidentRanges();
+    for (const auto& library : m_impl->snapshot())
     {
-        return std::shared_ptr<DynamicLibrary>(it->second.get(),
-                                               [](DynamicLibrary*) {});
+        const auto& impl = library->m_impl;
+        std::lock_guard<std::mutex> library_lock(impl->mutex);
+        total += impl->memoryFootprint(ranges);
     }
-    return nullptr;
+#endif
+    return total;
 }
 
 //!----------------------------------------------------------------------------
-bool DynamicLibraryManager::checkAllForUpdates()
+std::vector<NamespaceReport> DynamicLibraryManager::getNamespaceReport() const
 {
-    std::lock_guard<std::mutex> lock(m_impl->m_mutex);
-    for (const auto& library_pair : m_impl->m_libraries)
+    std::vector<NamespaceReport> reports;
+    std::unordered_set<long> seen;
+    for (const auto& library : m_impl->snapshot())
     {
-        if (library_pair.second->checkForUpdates())
+        NamespaceReport report = library->getNamespaceReport();
+        if (seen.insert(report.id).second)
         {
-            return true;
+            if (report.id == 0)
+            {
+                // The base namespace is shared by all non-isolated libraries
+                report.library.clear();
+            }
+            reports.push_back(std::move(report));
         }
     }
-    return false;
+    return reports;
 }
 
 } // namespace dl
\ No newline at end of file
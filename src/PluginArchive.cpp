@@ -0,0 +1,389 @@
+#include "DynamicLibrary/PluginArchive.hpp"
+#include <atomic>
+#include <cerrno>
+#include <cstdio>
+#include <cstring>
+#include <fstream>
+#include <iterator>
+#include <unordered_map>
+
+#ifdef _WIN32
+#    include <process.h>
+#else
+#    include <fcntl.h>
+#    include <sys/mman.h>
+#    include <sys/stat.h>
+#    include <unistd.h>
+#endif
+
+namespace dl
+{
+
+namespace
+{
+
+constexpr char ARCHIVE_MAGIC[8] = { 'D', 'L', 'P', 'L', 'U', 'G', 'A', '\0' };
+constexpr std::uint32_t ARCHIVE_VERSION = 1u;
+constexpr std::uint64_t ARCHIVE_ALIGNMENT = 4096u;
+constexpr std::size_t ARCHIVE_NAME_SIZE = 104u;
+
+//! ***************************************************************************
+//! \brief Header of the archive file
+//! ***************************************************************************
+struct ArchiveHeader
+{
+    char magic[8];
+    std::uint32_t version;
+    std::uint32_t count;
+    std::uint64_t alignment;
+};
+
+//! ***************************************************************************
+//! \brief Record of the index, one per library
+//! ***************************************************************************
+struct ArchiveRecord
+{
+    char name[ARCHIVE_NAME_SIZE];
+    std::uint64_t offset;
+    std::uint64_t size;
+    std::uint64_t hash;
+};
+
+static_assert(sizeof(ArchiveHeader) == 24u, "Unexpected header padding");
+static_assert(sizeof(ArchiveRecord) == 128u, "Unexpected record padding");
+
+//!----------------------------------------------------------------------------
+std::uint64_t alignUp(std::uint64_t p_value, std::uint64_t p_alignment)
+{
+    return (p_value + p_alignment - 1u) / p_alignment * p_alignment;
+}
+
+} // anonymous namespace
+
+//! ***************************************************************************
+//! \brief Implementation of PluginArchive
+//! ***************************************************************************
+class PluginArchive::Implementation
+{
+public:
+
+    const unsigned char* mapping = nullptr;
+    std::size_t mapping_size = 0u;
+    std::vector<Entry> entries;
+    std::unordered_map<std::string, std::size_t> index;
+    std::string error_message;
+
+    //!------------------------------------------------------------------------
+    //! \brief Destructor. Unmap the archive.
+    //!------------------------------------------------------------------------
+    ~Implementation()
+    {
+        unmap();
+    }
+
+    //!------------------------------------------------------------------------
+    //! \brief Unmap the archive and forget its index
+    //!------------------------------------------------------------------------
+    void unmap()
+    {
+#ifndef _WIN32
+        if (mapping)
+        {
+            munmap(const_cast<unsigned char*>(mapping), mapping_size);
+        }
+#endif
+        mapping = nullptr;
+        mapping_size = 0u;
+        entries.clear();
+        index.clear();
+    }
+
+    //!------------------------------------------------------------------------
+    //! \brief Check the header and read the index of the mapped archive
+    //! \param p_path Path of the archive (for error messages)
+    //! \return True if the archive is well formed, false otherwise
+    //!------------------------------------------------------------------------
+    bool parseIndex(const std::string& p_path)
+    {
+        if (mapping_size < sizeof(ArchiveHeader))
+        {
+            error_message = "Plugin archive '" + p_path + "' is truncated";
+            return false;
+        }
+
+        ArchiveHeader header;
+        std::memcpy(&header, mapping, sizeof(header));
+        if ((std::memcmp(header.magic, ARCHIVE_MAGIC, sizeof(ARCHIVE_MAGIC)) !=
+             0) ||
+            (header.version != ARCHIVE_VERSION))
+        {
+            error_message =
+                "File '" + p_path + "' is not a supported plugin archive";
+            return false;
+        }
+
+        std::uint64_t index_end =
+            sizeof(ArchiveHeader) +
+            std::uint64_t(header.count) * sizeof(ArchiveRecord);
+        if (index_end > mapping_size)
+        {
+            error_message = "Plugin archive '" + p_path + "' is truncated";
+            return false;
+        }
+
+        entries.reserve(header.count);
+        index.reserve(header.count);
+        for (std::uint32_t i = 0u; i < header.count; ++i)
+        {
+            ArchiveRecord record;
+            std::memcpy(&record,
+                        mapping + sizeof(ArchiveHeader) +
+                            i * sizeof(ArchiveRecord),
+                        sizeof(record));
+
+            if ((record.offset > mapping_size) ||
+                (record.size > mapping_size - record.offset))
+            {
+                error_message = "Plugin archive '" + p_path +
+                                "' has an entry out of bounds";
+                return false;
+            }
+
+            Entry entry;
+            entry.name.assign(record.name,
+                              strnlen(record.name, ARCHIVE_NAME_SIZE));
+            entry.offset = record.offset;
+            entry.size = record.size;
+            entry.hash = record.hash;
+            index[entry.name] = entries.size();
+            entries.push_back(std::move(entry));
+        }
+        return true;
+    }
+};
+
+//!----------------------------------------------------------------------------
+PluginArchive::PluginArchive() noexcept
+    : m_impl(std::make_unique<Implementation>())
+{
+}
+
+//!----------------------------------------------------------------------------
+PluginArchive::~PluginArchive() = default;
+
+//!----------------------------------------------------------------------------
+PluginArchive::PluginArchive(PluginArchive&& p_other) noexcept
+    : m_impl(std::move(p_other.m_impl))
+{
+}
+
+//!----------------------------------------------------------------------------
+PluginArchive& PluginArchive::operator=(PluginArchive&& p_other) noexcept
+{
+    if (this != &p_other)
+    {
+        m_impl = std::move(p_other.m_impl);
+    }
+    return *this;
+}
+
+//!----------------------------------------------------------------------------
+bool PluginArchive::create(
+    const std::string& p_archive_path,
+    const std::vector<std::pair<std::string, std::string>>& p_libraries)
+{
+    // Read all the libraries first so the index can be filled in one go.
+    std::vector<std::string> blobs;
+    std::vector<ArchiveRecord> records(p_libraries.size());
+    std::uint64_t offset =
+        alignUp(sizeof(ArchiveHeader) +
+                    p_libraries.size() * sizeof(ArchiveRecord),
+                ARCHIVE_ALIGNMENT);
+
+    blobs.reserve(p_libraries.size());
+    for (std::size_t i = 0u; i < p_libraries.size(); ++i)
+    {
+        const std::string& name = p_libraries[i].first;
+        const std::string& path = p_libraries[i].second;
+        if (name.empty() || (name.size() >= ARCHIVE_NAME_SIZE))
+        {
+            m_impl->error_message = "Invalid plugin archive entry name '" +
+                                    name + "'";
+            return false;
+        }
+
+        std::ifstream file(path, std::ios::binary);
+        if (!file.good())
+        {
+            m_impl->error_message =
+                "Library file does not exist or is not accessible: " + path;
+            return false;
+        }
+        blobs.emplace_back(std::istreambuf_iterator<char>(file),
+                           std::istreambuf_iterator<char>());
+
+        ArchiveRecord& record = records[i];
+        std::memset(&record, 0, sizeof(record));
+        std::memcpy(record.name, name.data(), name.size());
+        record.offset = offset;
+        record.size = blobs.back().size();
+        record.hash = hash(blobs.back().data(), blobs.back().size());
+        offset = alignUp(offset + record.size, ARCHIVE_ALIGNMENT);
+    }
+
+    ArchiveHeader header;
+    std::memcpy(header.magic, ARCHIVE_MAGIC, sizeof(ARCHIVE_MAGIC));
+    header.version = ARCHIVE_VERSION;
+    header.count = static_cast<std::uint32_t>(records.size());
+    header.alignment = ARCHIVE_ALIGNMENT;
+
+    // Same temporary name as the files written by DynamicLibrary: unique
+    // per process and per call
+    static std::atomic<std::uint64_t> counter{ 0u };
+#ifdef _WIN32
+    auto pid = _getpid();
+#else
+    auto pid = getpid();
+#endif
+    std::string tmp_path =
+        p_archive_path + "." + std::to_string(pid) + "." +
+        std::to_string(counter.fetch_add(1u, std::memory_order_relaxed));
+    {
+        std::ofstream file(tmp_path, std::ios::binary | std::ios::trunc);
+        if (!file.good())
+        {
+            m_impl->error_message =
+                "Failed to create plugin archive '" + tmp_path + "'";
+            return false;
+        }
+
+        file.write(reinterpret_cast<const char*>(&header), sizeof(header));
+        file.write(reinterpret_cast<const char*>(records.data()),
+                   std::streamsize(records.size() * sizeof(ArchiveRecord)));
+        for (std::size_t i = 0u; i < blobs.size(); ++i)
+        {
+            file.seekp(std::streamoff(records[i].offset));
+            file.write(blobs[i].data(), std::streamsize(blobs[i].size()));
+        }
+
+        if (!file.good())
+        {
+            m_impl->error_message =
+                "Failed to write plugin archive '" + tmp_path + "'";
+            return false;
+        }
+    }
+
+    if (std::rename(tmp_path.c_str(), p_archive_path.c_str()) != 0)
+    {
+        m_impl->error_message = "Failed to rename plugin archive '" +
+                                tmp_path + "': " + std::strerror(errno);
+        std::remove(tmp_path.c_str());
+        return false;
+    }
+    return true;
+}
+
+//!----------------------------------------------------------------------------
+bool PluginArchive::open(const std::string& p_archive_path)
+{
+    m_impl->unmap();
+
+#ifdef _WIN32
+    m_impl->error_message = "Plugin archives are not supported";
+    return false;
+#else
+    int fd = ::open(p_archive_path.c_str(), O_RDONLY | O_CLOEXEC);
+    if (fd < 0)
+    {
+        m_impl->error_message = "Failed to open plugin archive '" +
+                                p_archive_path + "': " + std::strerror(errno);
+        return false;
+    }
+
+    struct stat file_stat;
+    if ((fstat(fd, &file_stat) != 0) || (file_stat.st_size <= 0))
+    {
+        m_impl->error_message =
+            "Plugin archive '" + p_archive_path + "' is empty";
+        ::close(fd);
+        return false;
+    }
+
+    std::size_t size = static_cast<std::size_t>(file_stat.st_size);
+    void* mapping = mmap(nullptr, size, PROT_READ, MAP_PRIVATE, fd, 0);
+    ::close(fd); // The mapping keeps its own reference on the file
+    if (mapping == MAP_FAILED)
+    {
+        m_impl->error_message = "Failed to map plugin archive '" +
+                                p_archive_path + "': " + std::strerror(errno);
+        return false;
+    }
+
+    m_impl->mapping = static_cast<const unsigned char*>(mapping);
+    m_impl->mapping_size = size;
+    if (!m_impl->parseIndex(p_archive_path))
+    {
+        m_impl->unmap();
+        return false;
+    }
+    return true;
+#endif
+}
+
+//!----------------------------------------------------------------------------
+void PluginArchive::close()
+{
+    m_impl->unmap();
+}
+
+//!----------------------------------------------------------------------------
+bool PluginArchive::isOpen() const
+{
+    return m_impl->mapping != nullptr;
+}
+
+//!----------------------------------------------------------------------------
+const std::vector<PluginArchive::Entry>& PluginArchive::getEntries() const
+{
+    return m_impl->entries;
+}
+
+//!----------------------------------------------------------------------------
+const PluginArchive::Entry* PluginArchive::find(const std::string& p_name) const
+{
+    auto it = m_impl->index.find(p_name);
+    if (it == m_impl->index.end())
+    {
+        return nullptr;
+    }
+    return &m_impl->entries[it->second];
+}
+
+//!----------------------------------------------------------------------------
+const void* PluginArchive::getData(const Entry& p_entry) const
+{
+    return m_impl->mapping ? m_impl->mapping + p_entry.offset : nullptr;
+}
+
+//!----------------------------------------------------------------------------
+std::string PluginArchive::getErrorMessage() const
+{
+    return m_impl->error_message;
+}
+
+//!----------------------------------------------------------------------------
+std::uint64_t PluginArchive::hash(const void* p_data, std::size_t p_size)
+{
+    // FNV-1a 64
+    const unsigned char* data = static_cast<const unsigned char*>(p_data);
+    std::uint64_t result = 14695981039346656037ull;
+    for (std::size_t i = 0u; i < p_size; ++i)
+    {
+        result ^= data[i];
+        result *= 1099511628211ull;
+    }
+    return result;
+}
+
+} // namespace dl
@@ -0,0 +1,205 @@
+#include "DynamicLibrary/PluginMetadata.hpp"
+#include <cstring>
+#include <utility>
+
+#ifdef __linux__
+#    include <elf.h>
+#    include <fcntl.h>
+#    include <sys/mman.h>
+#    include <sys/stat.h>
+#    include <unistd.h>
+#endif
+
+namespace dl
+{
+
+#ifdef __linux__
+namespace
+{
+
+//!----------------------------------------------------------------------------
+//! \brief Split a comma-separated list, skipping the empty items
+//!----------------------------------------------------------------------------
+std::vector<std::string> splitList(const std::string& p_list)
+{
+    std::vector<std::string> items;
+    std::size_t begin = 0u;
+    while (begin <= p_list.size())
+    {
+        std::size_t end = p_list.find(',', begin);
+        if (end == std::string::npos)
+        {
+            end = p_list.size();
+        }
+        if (end > begin)
+        {
+            items.push_back(p_list.substr(begin, end - begin));
+        }
+        begin = end + 1u;
+    }
+    return items;
+}
+
+//!----------------------------------------------------------------------------
+//! \brief Decode the descriptor of the metadata note
+//!----------------------------------------------------------------------------
+void parseDescriptor(const char* p_desc,
+                     std::size_t p_size,
+                     PluginMetadata& p_metadata)
+{
+    std::string fields[4];
+    std::size_t field = 0u;
+    for (std::size_t i = 0u; (i < p_size) && (field < 4u); ++i)
+    {
+        if (p_desc[i] == '\0')
+        {
+            ++field;
+        }
+        else
+        {
+            fields[field].push_back(p_desc[i]);
+        }
+    }
+
+    p_metadata.name = fields[0];
+    p_metadata.version = fields[1];
+    p_metadata.capabilities = splitList(fields[2]);
+    p_metadata.required_symbols = splitList(fields[3]);
+}
+
+//!----------------------------------------------------------------------------
+//! \brief Look for the metadata note in the PT_NOTE segments of an ELF image
+//! \tparam Ehdr, Phdr ELF header and program header of the ELF class
+//! \return true if the note was found
+//!----------------------------------------------------------------------------
+template <typename Ehdr, typename Phdr>
+bool findMetadataNote(const unsigned char* p_data,
+                      std::size_t p_size,
+                      PluginMetadata& p_metadata)
+{
+    Ehdr header;
+    if (p_size < sizeof(header))
+    {
+        return false;
+    }
+    std::memcpy(&header, p_data, sizeof(header));
+    if ((header.e_phentsize != sizeof(Phdr)) || (header.e_phoff > p_size) ||
+        (header.e_phnum > (p_size - header.e_phoff) / sizeof(Phdr)))
+    {
+        return false;
+    }
+
+    const char name[] = DL_PLUGIN_NOTE_NAME;
+    for (std::size_t i = 0u; i < header.e_phnum; ++i)
+    {
+        Phdr segment;
+        std::memcpy(&segment,
+                    p_data + header.e_phoff + i * sizeof(Phdr),
+                    sizeof(segment));
+        if ((segment.p_type != PT_NOTE) || (segment.p_offset > p_size) ||
+            (segment.p_filesz > p_size - segment.p_offset))
+        {
+            continue;
+        }
+
+        // Notes are padded to the alignment of their segment
+        const std::size_t alignment = (segment.p_align == 8u) ? 8u : 4u;
+        auto align = [alignment](std::size_t p_value)
+        { return (p_value + alignment - 1u) & ~(alignment - 1u); };
+
+        std::size_t offset = 0u;
+        while (offset + sizeof(Elf32_Nhdr) <= segment.p_filesz)
+        {
+            Elf32_Nhdr note; // Same layout as Elf64_Nhdr
+            const unsigned char* ptr = p_data + segment.p_offset + offset;
+            std::memcpy(&note, ptr, sizeof(note));
+
+            std::size_t name_offset = sizeof(note);
+            std::size_t desc_offset = name_offset + align(note.n_namesz);
+            std::size_t next = desc_offset + align(note.n_descsz);
+            if (next > segment.p_filesz - offset)
+            {
+                break;
+            }
+
+            if ((note.n_type == DL_PLUGIN_NOTE_TYPE) &&
+                (note.n_namesz == sizeof(name)) &&
+                (std::memcmp(ptr + name_offset, name, sizeof(name)) == 0))
+            {
+                parseDescriptor(reinterpret_cast<const char*>(ptr) +
+                                    desc_offset,
+                                note.n_descsz,
+                                p_metadata);
+                return true;
+            }
+            offset += next;
+        }
+    }
+    return false;
+}
+
+} // anonymous namespace
+#endif
+
+//!----------------------------------------------------------------------------
+bool readPluginMetadata(const std::string& p_path,
+                        PluginMetadata& p_metadata)
+{
+#ifdef __linux__
+    int fd = ::open(p_path.c_str(), O_RDONLY | O_CLOEXEC);
+    if (fd < 0)
+    {
+        return false;
+    }
+
+    struct stat file_stat;
+    if ((fstat(fd, &file_stat) != 0) || !S_ISREG(file_stat.st_mode) ||
+        (file_stat.st_size < EI_NIDENT))
+    {
+        ::close(fd);
+        return false;
+    }
+
+    // Only the pages of the headers and of the notes are read from disk
+    std::size_t size = static_cast<std::size_t>(file_stat.st_size);
+    void* mapping = mmap(nullptr, size, PROT_READ, MAP_PRIVATE, fd, 0);
+    ::close(fd);
+    if (mapping == MAP_FAILED)
+    {
+        return false;
+    }
+
+    const auto* data = static_cast<const unsigned char*>(mapping);
+    bool found = false;
+    if ((std::memcmp(data, ELFMAG, SELFMAG) == 0) &&
+        (data[EI_DATA] == ((__BYTE_ORDER == __LITTLE_ENDIAN) ? ELFDATA2LSB
+                                                             : ELFDATA2MSB)))
+    {
+        PluginMetadata metadata;
+        if (data[EI_CLASS] == ELFCLASS64)
+        {
+            found = findMetadataNote<Elf64_Ehdr, Elf64_Phdr>(
+                data, size, metadata);
+        }
+        else if (data[EI_CLASS] == ELFCLASS32)
+        {
+            found = findMetadataNote<Elf32_Ehdr, Elf32_Phdr>(
+                data, size, metadata);
+        }
+        if (found)
+        {
+            metadata.path = p_path;
+            p_metadata = std::move(metadata);
+        }
+    }
+
+    munmap(mapping, size);
+    return found;
+#else
+    (void) p_path;
+    (void) p_metadata;
+    return false;
+#endif
+}
+
+} // namespace dl